@@ -1,4 +1,7 @@
 #include "Geometry.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
 
 namespace primal::tools {
 namespace {
@@ -6,13 +9,35 @@ namespace {
 using namespace math;
 using namespace DirectX;
 
+// Large meshes are split into ranges of this many triangles (or vertices) for the steps
+// that process them independently, so that one big mesh doesn't keep a single thread busy.
+constexpr u32 split_size{ 16 * 1024 };
+
+// A range of triangles or vertices of a mesh.
+struct mesh_range
+{
+    mesh*   m;
+    u32     begin;
+    u32     end;
+};
+
 void
-recalculate_normals(mesh& m)
+add_ranges(utl::vector<mesh_range>& ranges, mesh& m, u32 count)
 {
-    const u32 num_indices{ (u32)m.raw_indices.size() };
-    m.normals.resize(num_indices);
+    for (u32 begin{ 0 }; begin < count; begin += split_size)
+        ranges.emplace_back(mesh_range{ &m, begin, std::min(begin + split_size, count) });
+}
 
-    for (u32 i{ 0 }; i < num_indices; ++i)
+// Calculates the face normals of the triangles in [first_triangle, last_triangle).
+// NOTE: m.normals must already have one entry per index.
+void
+recalculate_normals(mesh& m, u32 first_triangle, u32 last_triangle)
+{
+    PROFILE_SCOPE("geometry::recalculate_normals");
+    const u32 num_indices{ last_triangle * 3 };
+    assert(m.normals.size() == m.raw_indices.size() && num_indices <= m.raw_indices.size());
+
+    for (u32 i{ first_triangle * 3 }; i < num_indices; ++i)
     {
         const u32 i0{ m.raw_indices[i] };
         const u32 i1{ m.raw_indices[++i] };
@@ -32,68 +57,302 @@ recalculate_normals(mesh& m)
     }
 }
 
+// Vertices with at most this many corners are welded by comparing their corners directly.
+// That's faster than hashing for the usual 4 to 8 corners per vertex.
+constexpr u32 hash_threshold{ 16 };
+
+// Vertex to corner adjacency in compressed sparse row form. The corners (index buffer positions)
+// that reference vertex v are corners[offsets[v]..offsets[v + 1]), in ascending order.
+struct vertex_corners
+{
+    utl::vector<u32>    offsets;
+    utl::vector<u32>    corners;
+
+    u32 count(u32 v) const { return offsets[v + 1] - offsets[v]; }
+    const u32* begin(u32 v) const { return &corners[offsets[v]]; }
+};
+
+// Two passes over the indices: count the corners of every vertex, then put them in place.
+void
+build_vertex_corners(const utl::vector<u32>& indices, u32 num_vertices, vertex_corners& adjacency)
+{
+    const u32 num_indices{ (u32)indices.size() };
+    adjacency.offsets.clear();
+    adjacency.offsets.resize(num_vertices + 1, 0);
+    for (u32 i{ 0 }; i < num_indices; ++i)
+    {
+        assert(indices[i] < num_vertices);
+        ++adjacency.offsets[indices[i] + 1];
+    }
+
+    for (u32 i{ 0 }; i < num_vertices; ++i)
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+    utl::vector<u32> cursor{ adjacency.offsets };
+    adjacency.corners.resize(num_indices);
+    for (u32 i{ 0 }; i < num_indices; ++i)
+        adjacency.corners[cursor[indices[i]]++] = i;
+}
+
+// Hash table with open addressing that maps 64-bit keys to indices. It's reused for
+// every vertex, so clear() only resets the slots that were used.
+class key_table
+{
+public:
+    // Makes room for at least count keys and removes the keys of the last use.
+    void clear(u32 count)
+    {
+        for (const u32 slot : _used) _values[slot] = u32_invalid_id;
+        _used.clear();
+
+        u32 capacity{ 16 };
+        while (capacity < count * 2) capacity <<= 1;
+        if (capacity > _values.size())
+        {
+            _keys.resize(capacity);
+            _values.clear();
+            _values.resize(capacity, u32_invalid_id);
+        }
+    }
+
+    // Returns u32_invalid_id if the key isn't in the table.
+    [[nodiscard]] u32 find(u64 key) const
+    {
+        const u64 mask{ _values.size() - 1 };
+        for (u64 slot{ hash(key) & mask }; _values[slot] != u32_invalid_id; slot = (slot + 1) & mask)
+        {
+            if (_keys[slot] == key) return _values[slot];
+        }
+
+        return u32_invalid_id;
+    }
+
+    // Returns the value of the key, which is u32_invalid_id if the key was just added.
+    u32& insert(u64 key)
+    {
+        const u64 mask{ _values.size() - 1 };
+        u64 slot{ hash(key) & mask };
+        while (_values[slot] != u32_invalid_id && _keys[slot] != key) slot = (slot + 1) & mask;
+        if (_values[slot] == u32_invalid_id)
+        {
+            assert(_used.size() < _values.size() / 2);
+            _keys[slot] = key;
+            _used.emplace_back((u32)slot);
+        }
+
+        return _values[slot];
+    }
+
+private:
+    static u64 hash(u64 key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return key;
+    }
+
+    utl::vector<u64>    _keys;
+    utl::vector<u32>    _values;
+    utl::vector<u32>    _used;
+};
+
+// Corners of one vertex with the same (quantized) normal. They're merged or kept apart together.
+struct normal_group
+{
+    v3      normal;         // normal of the first corner. It's used for the angle test.
+    v3      sum;            // sum of the normals of all corners in this group.
+    u32     first_corner;   // index into corner_next of the first corner of this group.
+    u32     last_corner;
+    u32     next;           // next group that isn't merged yet.
+};
+
+// Scratch memory for clustering the corners of one vertex at a time.
+struct normal_clusters
+{
+    key_table                   table;
+    utl::vector<normal_group>   groups;
+    utl::vector<u32>            corner_next;
+    // Output: the cluster of every corner of the vertex and the smoothed normal of every cluster.
+    utl::vector<u32>            corner_cluster;
+    utl::vector<v3>             normals;
+};
+
+struct smoothing
+{
+    f32     cos_alpha;
+    bool    is_hard_edge;
+    bool    is_soft_edge;
+
+    explicit smoothing(f32 smoothing_angle)
+        : cos_alpha{ XMScalarCos(pi - smoothing_angle * pi / 180.f) },
+        is_hard_edge{ XMScalarNearEqual(smoothing_angle, 180.f, epsilon) },
+        is_soft_edge{ XMScalarNearEqual(smoothing_angle, 0.f, epsilon) }
+    {}
+};
+
+u64
+normal_key(const v3& n)
+{
+    // NOTE: 21 bits per component with steps of 1/4096. Normals are expected to be unit length.
+    auto quantize = [](f32 f) { return (u64)((s32)std::lround(std::clamp(f, -255.f, 255.f) * 4096.f) & 0x1fffff); };
+    return quantize(n.x) | (quantize(n.y) << 21) | (quantize(n.z) << 42);
+}
+
+// Clusters the corners of one vertex by their normals. Clusters are numbered in the order
+// of their first corner. Returns the number of clusters.
+u32
+cluster_normals(const mesh& m, const u32 *const refs, u32 num_refs, const smoothing& s, normal_clusters& c)
+{
+    c.corner_cluster.resize(num_refs);
+    c.normals.clear();
+
+    if (s.is_hard_edge)
+    {
+        // Every corner is its own cluster.
+        for (u32 j{ 0 }; j < num_refs; ++j)
+        {
+            c.corner_cluster[j] = j;
+            XMStoreFloat3(&c.normals.emplace_back(), XMVector3Normalize(XMLoadFloat3(&m.normals[refs[j]])));
+        }
+        return num_refs;
+    }
+
+    if (s.is_soft_edge)
+    {
+        // All corners are in one cluster.
+        XMVECTOR n{ XMLoadFloat3(&m.normals[refs[0]]) };
+        c.corner_cluster[0] = 0;
+        for (u32 j{ 1 }; j < num_refs; ++j)
+        {
+            n += XMLoadFloat3(&m.normals[refs[j]]);
+            c.corner_cluster[j] = 0;
+        }
+        XMStoreFloat3(&c.normals.emplace_back(), XMVector3Normalize(n));
+        return 1;
+    }
+
+    // Group the corners with the same normal, in the order of their first corner.
+    // Vertices with few corners get one group per corner.
+    const bool use_table{ num_refs > hash_threshold };
+    if (use_table) c.table.clear(num_refs);
+    c.groups.clear();
+    c.corner_next.resize(num_refs);
+    for (u32 j{ 0 }; j < num_refs; ++j)
+    {
+        const v3& n{ m.normals[refs[j]] };
+        c.corner_next[j] = u32_invalid_id;
+        if (!use_table)
+        {
+            c.groups.emplace_back(normal_group{ n, n, j, j, j + 1 });
+            continue;
+        }
+
+        u32& slot{ c.table.insert(normal_key(n)) };
+        if (slot == u32_invalid_id)
+        {
+            slot = (u32)c.groups.size();
+            c.groups.emplace_back(normal_group{ n, n, j, j, slot + 1 });
+            continue;
+        }
+
+        normal_group& g{ c.groups[slot] };
+        XMStoreFloat3(&g.sum, XMLoadFloat3(&g.sum) + XMLoadFloat3(&n));
+        c.corner_next[g.last_corner] = j;
+        g.last_corner = j;
+    }
+
+    // Every group that isn't merged yet starts a new cluster and takes the later groups whose
+    // normals are within the smoothing angle. Merged groups are unlinked from the list.
+    const u32 num_groups{ (u32)c.groups.size() };
+    for (u32 j{ 0 }; j < num_groups; j = c.groups[j].next)
+    {
+        const u32 cluster{ (u32)c.normals.size() };
+        XMVECTOR n1{ XMLoadFloat3(&c.groups[j].sum) };
+        // The corners of the merged groups are chained to the corners of group j.
+        u32 last_corner{ c.groups[j].last_corner };
+        for (u32 previous{ j }, k{ c.groups[j].next }; k < num_groups; k = c.groups[k].next)
+        {
+            XMVECTOR n2{ XMLoadFloat3(&c.groups[k].normal) };
+            // NOTE: we're accounting for the length of n1 in this calculation because
+            //       it can possibly change in this loop iteration. We assume unit length
+            //       for n2.
+            //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
+            f32 cos_theta{ 0.f };
+            XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
+            if (cos_theta >= s.cos_alpha)
+            {
+                n1 += XMLoadFloat3(&c.groups[k].sum);
+                c.groups[previous].next = c.groups[k].next;
+                c.corner_next[last_corner] = c.groups[k].first_corner;
+                last_corner = c.groups[k].last_corner;
+            }
+            else previous = k;
+        }
+
+        for (u32 corner{ c.groups[j].first_corner }; corner != u32_invalid_id; corner = c.corner_next[corner])
+            c.corner_cluster[corner] = cluster;
+
+        XMStoreFloat3(&c.normals.emplace_back(), XMVector3Normalize(n1));
+    }
+
+    return (u32)c.normals.size();
+}
+
 void
 process_normals(mesh& m, f32 smoothing_angle)
 {
-    const f32 cos_alpha{ XMScalarCos(pi - smoothing_angle * pi / 180.f) };
-    const bool is_hard_edge{ XMScalarNearEqual(smoothing_angle, 180.f, epsilon) };
-    const bool is_soft_edge{ XMScalarNearEqual(smoothing_angle, 0.f, epsilon) };
+    PROFILE_SCOPE("geometry::process_normals");
+    const smoothing s{ smoothing_angle };
     const u32 num_indices{ (u32)m.raw_indices.size() };
     const u32 num_vertices{ (u32)m.positions.size() };
     assert(num_indices && num_vertices);
 
     m.indices.resize(num_indices);
+    m.vertices.reserve(num_vertices);
 
-    utl::vector<utl::vector<u32>> idx_ref(num_vertices);
-    for (u32 i{ 0 }; i < num_indices; ++i)
-        idx_ref[m.raw_indices[i]].emplace_back(i);
+    vertex_corners adjacency{};
+    build_vertex_corners(m.raw_indices, num_vertices, adjacency);
 
+    normal_clusters clusters{};
     for (u32 i{ 0 }; i < num_vertices; ++i)
     {
-        auto& refs{ idx_ref[i] };
-        u32 num_refs{ (u32)refs.size() };
-        for (u32 j{ 0 }; j < num_refs; ++j)
+        const u32 num_refs{ adjacency.count(i) };
+        if (!num_refs) continue;
+        const u32 *const refs{ adjacency.begin(i) };
+
+        const u32 first_vertex{ (u32)m.vertices.size() };
+        const u32 num_clusters{ cluster_normals(m, refs, num_refs, s, clusters) };
+        for (u32 j{ 0 }; j < num_clusters; ++j)
         {
-            m.indices[refs[j]] = (u32)m.vertices.size();
             vertex& v{ m.vertices.emplace_back() };
-            v.position = m.positions[m.raw_indices[refs[j]]];
+            v.position = m.positions[i];
+            v.normal = clusters.normals[j];
+        }
 
-            XMVECTOR n1{ XMLoadFloat3(&m.normals[refs[j]]) };
-            if (!is_hard_edge)
-            {
-                for (u32 k{ j + 1 }; k < num_refs; ++k)
-                {
-                    // this value represents the cosine of the angle between normals.
-                    f32 cos_theta{ 0.f };
-                    XMVECTOR n2{ XMLoadFloat3(&m.normals[refs[k]]) };
-                    if (!is_soft_edge)
-                    {
-                        // NOTE: we're accounting for the length of n1 in this calculation because
-                        //       it can possibly change in this loop iteration. We assume unit length
-                        //       for n2. 
-                        //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
-                        XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
-                    }
+        for (u32 j{ 0 }; j < num_refs; ++j)
+            m.indices[refs[j]] = first_vertex + clusters.corner_cluster[j];
+    }
+}
 
-                    if (is_soft_edge || cos_theta >= cos_alpha)
-                    {
-                        n1 += n2;
+// Returns the index of the grid cell of a texture coordinate. The cells are epsilon wide,
+// so texture coordinates that are nearly equal are in the same or in a neighboring cell.
+s64
+uv_cell(f32 f)
+{
+    return (s64)std::floor(std::clamp((f64)f / epsilon, -1e15, 1e15));
+}
 
-                        m.indices[refs[k]] = m.indices[refs[j]];
-                        refs.erase(refs.begin() + k);
-                        --num_refs;
-                        --k;
-                    }
-                }
-            }
-            XMStoreFloat3(&v.normal, XMVector3Normalize(n1));
-        }
-    }
+u64
+uv_cell_key(s64 x, s64 y)
+{
+    return (u64)x * 0x9e3779b97f4a7c15ull ^ (u64)y;
 }
 
 void
 process_uvs(mesh& m)
 {
+    PROFILE_SCOPE("geometry::process_uvs");
     utl::vector<vertex> old_vertices;
     old_vertices.swap(m.vertices);
     utl::vector<u32> old_indices(m.indices.size());
@@ -102,46 +361,87 @@ process_uvs(mesh& m)
     const u32 num_vertices{ (u32)old_vertices.size() };
     const u32 num_indices{ (u32)old_indices.size() };
     assert(num_vertices && num_indices);
+    m.vertices.reserve(num_vertices);
 
-    utl::vector<utl::vector<u32>> idx_ref(num_vertices);
-    for (u32 i{ 0 }; i < num_indices; ++i)
-        idx_ref[old_indices[i]].emplace_back(i);
+    vertex_corners adjacency{};
+    build_vertex_corners(old_indices, num_vertices, adjacency);
 
+    // The texture coordinates of the first corner of every new vertex are stored in a grid.
+    // A corner uses the first vertex whose texture coordinates are nearly equal to its own,
+    // so we only look at the 3x3 cells around it. Vertices in the same cell are chained.
+    key_table table{};
+    utl::vector<u32> cell_next;
     for (u32 i{ 0 }; i < num_vertices; ++i)
     {
-        auto& refs{ idx_ref[i] };
-        u32 num_refs{ (u32)refs.size() };
+        const u32 num_refs{ adjacency.count(i) };
+        if (!num_refs) continue;
+        const u32 *const refs{ adjacency.begin(i) };
+        const u32 first_vertex{ (u32)m.vertices.size() };
+
+        if (num_refs <= hash_threshold)
+        {
+            for (u32 j{ 0 }; j < num_refs; ++j)
+            {
+                const v2& uv{ m.uv_sets[0][refs[j]] };
+                u32 match{ first_vertex };
+                for (; match < m.vertices.size(); ++match)
+                {
+                    const v2& uv0{ m.vertices[match].uv };
+                    if (XMScalarNearEqual(uv0.x, uv.x, epsilon) && XMScalarNearEqual(uv0.y, uv.y, epsilon)) break;
+                }
+
+                if (match == m.vertices.size()) m.vertices.emplace_back(old_vertices[i]).uv = uv;
+                m.indices[refs[j]] = match;
+            }
+            continue;
+        }
+
+        table.clear(num_refs);
+        cell_next.clear();
         for (u32 j{ 0 }; j < num_refs; ++j)
         {
-            m.indices[refs[j]] = (u32)m.vertices.size();
-            vertex& v{ old_vertices[old_indices[refs[j]]] };
-            v.uv = m.uv_sets[0][refs[j]];
-            m.vertices.emplace_back(v);
+            const v2& uv{ m.uv_sets[0][refs[j]] };
+            const s64 x{ uv_cell(uv.x) };
+            const s64 y{ uv_cell(uv.y) };
 
-            for (u32 k{ j + 1 }; k < num_refs; ++k)
-            {
-                v2& uv1{ m.uv_sets[0][refs[k]] };
-                if (XMScalarNearEqual(v.uv.x, uv1.x, epsilon) &&
-                    XMScalarNearEqual(v.uv.y, uv1.y, epsilon))
+            u32 match{ u32_invalid_id };
+            for (s64 cy{ y - 1 }; cy <= y + 1; ++cy)
+                for (s64 cx{ x - 1 }; cx <= x + 1; ++cx)
                 {
-                    m.indices[refs[k]] = m.indices[refs[j]];
-                    refs.erase(refs.begin() + k);
-                    --num_refs;
-                    --k;
+                    for (u32 k{ table.find(uv_cell_key(cx, cy)) }; k != u32_invalid_id; k = cell_next[k - first_vertex])
+                    {
+                        const v2& uv0{ m.vertices[k].uv };
+                        if (k < match && XMScalarNearEqual(uv0.x, uv.x, epsilon) && XMScalarNearEqual(uv0.y, uv.y, epsilon))
+                            match = k;
+                    }
                 }
+
+            if (match == u32_invalid_id)
+            {
+                match = (u32)m.vertices.size();
+                vertex& v{ m.vertices.emplace_back(old_vertices[i]) };
+                v.uv = uv;
+
+                u32& head{ table.insert(uv_cell_key(x, y)) };
+                assert(cell_next.size() == match - first_vertex);
+                cell_next.emplace_back(head);
+                head = match;
             }
+
+            m.indices[refs[j]] = match;
         }
     }
 }
 
+// Packs the vertices in [first_vertex, last_vertex).
+// NOTE: m.packed_vertices_static must already have one entry per vertex.
 void
-pack_vertices_static(mesh& m)
+pack_vertices_static(mesh& m, u32 first_vertex, u32 last_vertex)
 {
-    const u32 num_vertices{ (u32)m.vertices.size() };
-    assert(num_vertices);
-    m.packed_vertices_static.reserve(num_vertices);
+    PROFILE_SCOPE("geometry::pack_vertices_static");
+    assert(m.packed_vertices_static.size() == m.vertices.size() && last_vertex <= m.vertices.size());
 
-    for (u32 i{ 0 }; i < num_vertices; ++i)
+    for (u32 i{ first_vertex }; i < last_vertex; ++i)
     {
         vertex& v{ m.vertices[i] };
         const u8 signs{ (u8)((v.normal.z > 0.f) << 1) };
@@ -149,23 +449,167 @@ pack_vertices_static(mesh& m)
         const u16 normal_y{ (u16)pack_float<16>(v.normal.y, -1.f, 1.f) };
         // TODO: pack tangents in sign and in x/y components
 
-        m.packed_vertices_static
-            .emplace_back(packed_vertex::vertex_static
-                          {
-                              v.position, {0, 0, 0}, signs,
-                              {normal_x, normal_y}, {},
-                              v.uv
-                          });
+        m.packed_vertices_static[i] = packed_vertex::vertex_static
+        {
+            v.position, {0, 0, 0}, signs,
+            {normal_x, normal_y}, {},
+            v.uv
+        };
     }
 }
 
+// Quantized attributes of a corner. Corners of the same position with equal keys share a vertex.
+// NOTE: the vertex format only has one set of texture coordinates, so only the first set is used.
+struct corner_key
+{
+    u32     normal_cluster;
+    s32     uv[2];
+    s32     tangent[4];
+
+    bool operator==(const corner_key& o) const { return !memcmp(this, &o, sizeof(corner_key)); }
+};
+
+s32
+quantize_uv(f32 f)
+{
+    return (s32)std::floor(std::clamp((f64)f / epsilon, (f64)INT32_MIN, (f64)INT32_MAX));
+}
+
+s32
+quantize_tangent(f32 f)
+{
+    return (s32)std::lround(std::clamp(f, -255.f, 255.f) * 4096.f);
+}
+
+u64
+hash_key(const corner_key& key)
+{
+    u64 hash{ key.normal_cluster };
+    for (const s32 v : key.uv) hash = hash * 0x9e3779b97f4a7c15ull + (u32)v;
+    for (const s32 v : key.tangent) hash = hash * 0x9e3779b97f4a7c15ull + (u32)v;
+    return hash;
+}
+
+// Builds the final vertices and indices in one pass over the corners of every position. Every corner
+// gets the smoothed normal of its cluster and is looked up in a hash table by its key, so there's no
+// intermediate vertex buffer and no second adjacency table like in the separate passes.
+// NOTE: texture coordinates are compared in epsilon-sized cells, so nearly equal coordinates in
+//       neighboring cells aren't merged like in process_uvs(). This only adds a vertex.
+void
+process_vertices_unified(mesh& m, f32 smoothing_angle)
+{
+    PROFILE_SCOPE("geometry::process_vertices_unified");
+    const smoothing s{ smoothing_angle };
+    const u32 num_indices{ (u32)m.raw_indices.size() };
+    const u32 num_vertices{ (u32)m.positions.size() };
+    assert(num_indices && num_vertices);
+    const bool has_uvs{ !m.uv_sets.empty() };
+    const bool has_tangents{ !m.tangents.empty() };
+
+    m.indices.resize(num_indices);
+    m.vertices.reserve(num_vertices);
+
+    vertex_corners adjacency{};
+    build_vertex_corners(m.raw_indices, num_vertices, adjacency);
+
+    normal_clusters clusters{};
+    key_table table{};
+    // The keys of the vertices of the current position. Vertices with the same hash are chained.
+    utl::vector<corner_key> keys;
+    utl::vector<u32> next;
+    for (u32 i{ 0 }; i < num_vertices; ++i)
+    {
+        const u32 num_refs{ adjacency.count(i) };
+        if (!num_refs) continue;
+        const u32 *const refs{ adjacency.begin(i) };
+
+        cluster_normals(m, refs, num_refs, s, clusters);
+        const u32 first_vertex{ (u32)m.vertices.size() };
+        const bool use_table{ num_refs > hash_threshold };
+        if (use_table) table.clear(num_refs);
+        keys.clear();
+        next.clear();
+
+        for (u32 j{ 0 }; j < num_refs; ++j)
+        {
+            const u32 corner{ refs[j] };
+            corner_key key{ clusters.corner_cluster[j] };
+            if (has_uvs)
+            {
+                const v2& uv{ m.uv_sets[0][corner] };
+                key.uv[0] = quantize_uv(uv.x);
+                key.uv[1] = quantize_uv(uv.y);
+            }
+            if (has_tangents)
+            {
+                const v4& t{ m.tangents[corner] };
+                key.tangent[0] = quantize_tangent(t.x);
+                key.tangent[1] = quantize_tangent(t.y);
+                key.tangent[2] = quantize_tangent(t.z);
+                key.tangent[3] = quantize_tangent(t.w);
+            }
+
+            // Vertices with few corners compare the keys directly.
+            u32 match{ u32_invalid_id };
+            u32 *const head{ use_table ? &table.insert(hash_key(key)) : nullptr };
+            if (head)
+            {
+                for (match = *head; match != u32_invalid_id && !(keys[match - first_vertex] == key);)
+                    match = next[match - first_vertex];
+            }
+            else
+            {
+                for (u32 k{ 0 }; k < keys.size() && match == u32_invalid_id; ++k)
+                    if (keys[k] == key) match = first_vertex + k;
+            }
+
+            if (match == u32_invalid_id)
+            {
+                match = (u32)m.vertices.size();
+                vertex& v{ m.vertices.emplace_back() };
+                v.position = m.positions[i];
+                v.normal = clusters.normals[key.normal_cluster];
+                if (has_uvs) v.uv = m.uv_sets[0][corner];
+                if (has_tangents) v.tangent = m.tangents[corner];
+
+                keys.emplace_back(key);
+                if (head)
+                {
+                    next.emplace_back(*head);
+                    *head = match;
+                }
+            }
+
+            m.indices[corner] = match;
+        }
+    }
+}
+
+// The unified pass needs every attribute per corner. Meshes that have some of them
+// per position (e.g. tangents) use the separate passes.
+bool
+has_corner_attributes(const mesh& m)
+{
+    const u64 num_indices{ m.raw_indices.size() };
+    if (m.normals.size() != num_indices) return false;
+    if (!m.tangents.empty() && m.tangents.size() != num_indices) return false;
+    for (const auto& uvs : m.uv_sets)
+    {
+        if (uvs.size() != num_indices) return false;
+    }
+
+    return true;
+}
+
+// Merges the vertices of a mesh. This step isn't split, so it runs once per mesh.
 void
 process_vertices(mesh& m, const geometry_import_settings& settings)
 {
-    assert((m.raw_indices.size() % 3) == 0);
-    if (settings.calculate_normals || m.normals.empty())
+    PROFILE_SCOPE("geometry::process_vertices");
+    if (has_corner_attributes(m))
     {
-        recalculate_normals(m);
+        process_vertices_unified(m, settings.smoothing_angle);
+        return;
     }
 
     process_normals(m, settings.smoothing_angle);
@@ -174,8 +618,6 @@ process_vertices(mesh& m, const geometry_import_settings& settings)
     {
         process_uvs(m);
     }
-
-    pack_vertices_static(m);
 }
 
 u64
@@ -284,16 +726,51 @@ pack_mesh_data(const mesh& m, u8* const buffer, u64& at)
 void
 process_scene(scene& scene, const geometry_import_settings& settings)
 {
+    PROFILE_SCOPE("geometry::process_scene");
+    // Every mesh is processed independently and only writes its own data, so the result
+    // doesn't depend on the order in which the threads process the meshes.
+    utl::vector<mesh*> meshes;
     for (auto& lod : scene.lod_groups)
         for (auto& m : lod.meshes)
         {
-            process_vertices(m, settings);
+            assert((m.raw_indices.size() % 3) == 0);
+            meshes.emplace_back(&m);
+        }
+
+    // 1. Face normals, split into ranges of triangles.
+    utl::vector<mesh_range> ranges;
+    for (mesh* m : meshes)
+    {
+        if (settings.calculate_normals || m->normals.empty())
+        {
+            m->normals.resize(m->raw_indices.size());
+            add_ranges(ranges, *m, (u32)m->raw_indices.size() / 3);
         }
+    }
+
+    workers::parallel_for((u32)ranges.size(), [&ranges](u32 i) { recalculate_normals(*ranges[i].m, ranges[i].begin, ranges[i].end); });
+
+    // 2. Vertex merging, one mesh per item. We start with the biggest meshes, so that
+    //    the small ones can fill the gaps at the end.
+    utl::vector<mesh*> by_size{ meshes };
+    std::stable_sort(by_size.begin(), by_size.end(), [](const mesh* a, const mesh* b) { return a->raw_indices.size() > b->raw_indices.size(); });
+    workers::parallel_for((u32)by_size.size(), [&by_size, &settings](u32 i) { process_vertices(*by_size[i], settings); });
+
+    // 3. Packing, split into ranges of vertices.
+    ranges.clear();
+    for (mesh* m : meshes)
+    {
+        m->packed_vertices_static.resize(m->vertices.size());
+        add_ranges(ranges, *m, (u32)m->vertices.size());
+    }
+
+    workers::parallel_for((u32)ranges.size(), [&ranges](u32 i) { pack_vertices_static(*ranges[i].m, ranges[i].begin, ranges[i].end); });
 }
 
 void
 pack_data(const scene& scene, scene_data& data)
 {
+    PROFILE_SCOPE("geometry::pack_data");
     constexpr u64 su32{ sizeof(u32) };
     const u64 scene_size{ get_scene_size(scene) };
     data.buffer_size = (u32)scene_size;
@@ -291,4 +291,13 @@ CreatePrimitiveMesh(scene_data* data, primitive_init_info* info)
     pack_data(scene, *data);
 }
 
+// Saves what the profiler recorded in the content tools (e.g. the geometry processing
+// stages) in the Chrome trace format.
+EDITOR_INTERFACE u32
+SaveProfilerTrace(const char* path)
+{
+    assert(path);
+    return profiler::save_chrome_trace(path) ? TRUE : FALSE;
+}
+
 }
\ No newline at end of file
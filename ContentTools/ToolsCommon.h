@@ -1,5 +1,6 @@
 #pragma once
 #include "CommonHeaders.h"
+#include "..\Utilities\Profiler.h"
 #include <combaseapi.h>
 
 #ifndef EDITOR_INTERFACE
@@ -0,0 +1,130 @@
+#include "WorkerPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // !WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace primal::tools::workers {
+namespace {
+
+struct batch
+{
+    item_function       function;
+    void*               data;
+    u32                 count;
+    std::atomic<u32>    next{ 0 };
+};
+
+std::unique_ptr<std::thread[]>  threads;
+u32                             thread_count{ 0 };
+// Only one batch runs at a time. The editor might import on several threads.
+std::mutex                      run_mutex;
+std::mutex                      mutex;
+std::condition_variable         wake_condition;
+std::condition_variable         done_condition;
+batch*                          current_batch{ nullptr };
+u64                             generation{ 0 };
+u32                             busy_workers{ 0 };
+
+void
+run_items(batch& b)
+{
+    for (u32 i{ b.next.fetch_add(1, std::memory_order_relaxed) }; i < b.count; i = b.next.fetch_add(1, std::memory_order_relaxed))
+        b.function(b.data, i);
+}
+
+void
+worker_loop()
+{
+    PROFILE_THREAD_NAME("tools worker");
+    u64 seen{ 0 };
+    while (true)
+    {
+        batch* b{ nullptr };
+        {
+            std::unique_lock lock{ mutex };
+            wake_condition.wait(lock, [&seen]() { return generation != seen; });
+            seen = generation;
+            b = current_batch;
+        }
+
+        run_items(*b);
+
+        std::lock_guard lock{ mutex };
+        if (--busy_workers == 0) done_condition.notify_one();
+    }
+}
+
+// NOTE: must be called with run_mutex locked.
+void
+start_workers()
+{
+    if (threads) return;
+    // NOTE: the calling thread also runs items, so we need one worker less than there are cores.
+    const u32 hardware_threads{ std::thread::hardware_concurrency() };
+    thread_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    if (!thread_count) return;
+
+    // NOTE: we can't stop the workers in DllMain, because they need the loader lock to exit.
+    //       So we pin the DLL instead: it stays loaded until the process exits, and the workers with it.
+    HMODULE module{ nullptr };
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                       (LPCWSTR)&start_workers, &module);
+    threads = std::make_unique<std::thread[]>(thread_count);
+    for (u32 i{ 0 }; i < thread_count; ++i) threads[i] = std::thread{ worker_loop };
+}
+
+} // anonymous namespace
+
+void
+run(u32 count, item_function function, void* data)
+{
+    assert(function);
+    batch b{ function, data, count };
+    if (count <= 1)
+    {
+        run_items(b);
+        return;
+    }
+
+    std::lock_guard run_lock{ run_mutex };
+    start_workers();
+    if (!thread_count)
+    {
+        run_items(b);
+        return;
+    }
+
+    {
+        std::lock_guard lock{ mutex };
+        current_batch = &b;
+        busy_workers = thread_count;
+        ++generation;
+    }
+    wake_condition.notify_all();
+
+    run_items(b);
+
+    // NOTE: every worker has to pick up the batch before we return, because b lives on our stack.
+    std::unique_lock lock{ mutex };
+    done_condition.wait(lock, []() { return busy_workers == 0; });
+    current_batch = nullptr;
+}
+
+void
+shutdown()
+{
+    // NOTE: the OS has already terminated the workers when the process exits. We only release
+    //       the thread objects, because destroying a joinable thread would call std::terminate().
+    if (!threads) return;
+    for (u32 i{ 0 }; i < thread_count; ++i) threads[i].detach();
+    threads.reset();
+    thread_count = 0;
+}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include "ToolsCommon.h"
+#include <type_traits>
+
+// NOTE: the content tools don't link the engine, so they can't use its job system.
+//       The workers are started when they're first needed and they're kept until the process exits,
+//       so every import uses the same threads (and the same profiler buffers).
+namespace primal::tools::workers {
+
+using item_function = void(*)(void* data, u32 index);
+
+// Calls function(data, i) for every i in [0, count) on the workers and the calling thread and
+// waits for all of them. Every thread takes the next item from a shared counter, so threads
+// that finish small items take over the remaining work.
+void run(u32 count, item_function function, void* data);
+// Called by DllMain when the process exits.
+void shutdown();
+
+namespace detail {
+template<typename F>
+void
+call_item_function(void* data, u32 index)
+{
+    (*static_cast<F*>(data))(index);
+}
+} // namespace detail
+
+// Calls f(i) for every i in [0, count) in parallel.
+template<typename F>
+void
+parallel_for(u32 count, F&& f)
+{
+    using function_type = std::remove_reference_t<F>;
+    run(count, &detail::call_item_function<function_type>, (void*)&f);
+}
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+// DllMain.cpp : Defines the entry point for the DLL application.
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "WorkerPool.h"
+
+BOOL APIENTRY DllMain( HMODULE hModule,
+                       DWORD  ul_reason_for_call,
+                       LPVOID lpReserved )
+{
+    switch (ul_reason_for_call)
+    {
+    case DLL_PROCESS_DETACH:
+        primal::tools::workers::shutdown();
+        break;
+    case DLL_PROCESS_ATTACH:
+    case DLL_THREAD_ATTACH:
+    case DLL_THREAD_DETACH:
+        break;
+    }
+    return TRUE;
+}
\ No newline at end of file
@@ -48,6 +48,13 @@ new_generation(id_type id)
     return index(id) | (generation << detail::index_bits);
 }
 
+constexpr id_type
+make_id(id_type index, id_type generation)
+{
+    assert(index < detail::index_mask && generation <= detail::generation_mask);
+    return index | (generation << detail::index_bits);
+}
+
 #if _DEBUG
 namespace detail {
 struct id_base
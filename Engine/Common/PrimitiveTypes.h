@@ -18,4 +18,5 @@ constexpr u32 u32_invalid_id{ 0xffff'ffffui32 };
 constexpr u16 u16_invalid_id{ 0xffffui16 };
 constexpr u8 u8_invalid_id{ 0xffui8 };
 
-using f32 = float;
\ No newline at end of file
+using f32 = float;
+using f64 = double;
\ No newline at end of file
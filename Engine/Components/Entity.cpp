@@ -1,6 +1,12 @@
 #include "Entity.h"
 #include "Transform.h"
 #include "Script.h"
+#include "Snapshot.h"
+#include "Event.h"
+#include "Recording.h"
+#include "..\Core\Metrics.h"
+#include <atomic>
+#include <algorithm>
 
 namespace primal::game_entity {
 
@@ -11,38 +17,108 @@ utl::vector<script::component>          scripts;
 
 utl::vector<id::generation_type>        generations;
 utl::deque<entity_id>                   free_ids;
+utl::vector<u8>                         states;
 
-} // anonymous namespace
+enum state_flags : u8
+{
+    inactive = 0x01,
+    stationary = 0x02,
+};
 
-entity
-create(entity_info info)
+enum class command_type : u32
 {
-    assert(info.transform); // All game entities must have a transform component
-    if (!info.transform) return entity{};
+    create,
+    remove,
+    add_script,
+    remove_script,
+    activate,
+    deactivate,
+    make_static,
+    make_movable,
+};
 
-    entity_id id;
+// NOTE: commands store copies of the init data, because the pointers in
+//       entity_info are only valid during the call that recorded the command.
+struct command
+{
+    command_type                    type;
+    entity_id                       id;
+    u32                             sequence;
+    transform::init_info            transform;
+    script::init_info               script;
+};
+
+using command_buffer = utl::vector<command>;
+
+utl::vector<std::unique_ptr<command_buffer>>    command_buffers;
+std::mutex                                      command_buffers_mutex;
+std::atomic<u32>                                command_sequence{ 0 };
+std::atomic<u32>                                deferred_phase_depth{ 0 };
+
+// Number of new entity slots that were reserved during the current deferred phase.
+// These are appended to the component arrays when the commands are played back.
+u32                                             reserved_slots{ 0 };
+std::mutex                                      reserve_mutex;
+
+// NOTE: the gauges are sampled in metrics::end_frame(), which runs on the main thread.
+const metrics::metric_id                        live_entities_metric{ metrics::register_gauge("entities.live", 0.0,
+                                                    [](void*) { return (f64)(generations.size() - free_ids.size()); }) };
+const metrics::metric_id                        free_ids_metric{ metrics::register_gauge("entities.free_ids", 0.0,
+                                                    [](void*) { return (f64)free_ids.size(); }) };
+const metrics::metric_id                        created_metric{ metrics::register_counter("entities.created") };
+const metrics::metric_id                        removed_metric{ metrics::register_counter("entities.removed") };
+const metrics::metric_id                        commands_metric{ metrics::register_counter("entities.deferred_commands") };
+
+command_buffer&
+thread_command_buffer()
+{
+    thread_local command_buffer* buffer{ nullptr };
+    if (!buffer)
+    {
+        std::lock_guard lock{ command_buffers_mutex };
+        buffer = command_buffers.emplace_back(std::make_unique<command_buffer>()).get();
+    }
 
+    return *buffer;
+}
+
+void
+record(command_type type, entity_id id, const transform::init_info* transform_info = nullptr,
+       const script::init_info* script_info = nullptr)
+{
+    metrics::add(commands_metric);
+    command& c{ thread_command_buffer().emplace_back() };
+    c.type = type;
+    c.id = id;
+    c.sequence = command_sequence.fetch_add(1, std::memory_order_relaxed);
+    c.transform = transform_info ? *transform_info : transform::init_info{};
+    c.script = script_info ? *script_info : script::init_info{};
+}
+
+// Reserves an entity id without touching the component arrays, so other threads
+// can still safely read them during a deferred phase.
+entity_id
+reserve_id()
+{
+    std::lock_guard lock{ reserve_mutex };
     if (free_ids.size() > id::min_deleted_elements)
     {
-        id = free_ids.front();
+        const entity_id id{ free_ids.front() };
         assert(!is_alive(id));
         free_ids.pop_front();
-        id = entity_id{ id::new_generation(id) };
-        ++generations[id::index(id)];
+        return entity_id{ id::new_generation(id) };
     }
-    else
-    {
-        id = entity_id{ (id::id_type)generations.size() };
-        generations.push_back(0);
 
-        // Resize components
-        // NOTE: we don't call resize(), so the number of memory allocations stays low
-        transforms.emplace_back();
-        scripts.emplace_back();
-    }
+    return entity_id{ (id::id_type)(generations.size() + reserved_slots++) };
+}
 
+entity
+create_components(entity_id id, entity_info info)
+{
     const entity new_entity{ id };
     const id::id_type index{ id::index(id) };
+    states[index] = 0;
+    metrics::add(created_metric);
 
     // Create transform component
     assert(!transforms[index].is_valid());
@@ -55,16 +131,16 @@ create(entity_info info)
         assert(!scripts[index].is_valid());
         scripts[index] = script::create(*info.script, new_entity);
         assert(scripts[index].is_valid());
+        script::begin_play(scripts[index]);
     }
 
     return new_entity;
 }
 
 void
-remove(entity_id id)
+remove_components(entity_id id)
 {
     const id::id_type index{ id::index(id) };
-    assert(is_alive(id));
 
     if (scripts[index].is_valid())
     {
@@ -74,18 +150,456 @@ remove(entity_id id)
 
     transform::remove(transforms[index]);
     transforms[index] = {};
+    event::remove_subscriptions(id);
+    metrics::add(removed_metric);
+}
+
+void
+set_script_component(entity_id id, const script::init_info* info)
+{
+    const id::id_type index{ id::index(id) };
+    if (scripts[index].is_valid())
+    {
+        script::remove(scripts[index]);
+        scripts[index] = {};
+    }
+
+    if (info && info->script_creator)
+    {
+        scripts[index] = script::create(*info, entity{ id });
+        assert(scripts[index].is_valid());
+        if (states[index] & state_flags::inactive) script::set_active(scripts[index], false);
+        script::begin_play(scripts[index]);
+    }
+}
+
+void
+set_active_state(entity_id id, bool active)
+{
+    const id::id_type index{ id::index(id) };
+    if (active == !(states[index] & state_flags::inactive)) return;
+    states[index] ^= state_flags::inactive;
+    if (scripts[index].is_valid()) script::set_active(scripts[index], active);
+}
+
+void
+set_static_state(entity_id id, bool is_static)
+{
+    const id::id_type index{ id::index(id) };
+    if (is_static) states[index] |= state_flags::stationary;
+    else states[index] &= ~state_flags::stationary;
+}
+
+// Applies all commands that were recorded for one entity slot. The commands are
+// sorted by sequence number, so we can coalesce them into their net effect:
+// - create + remove in the same phase cancel out (only the id is recycled).
+// - remove wins over any other change made to an existing entity.
+// - only the last script change and the last activation and mobility changes are applied.
+void
+apply_commands(const command *const cmds, u32 count)
+{
+    const command* create_cmd{ nullptr };
+    const command* script_cmd{ nullptr };
+    const command* active_cmd{ nullptr };
+    const command* static_cmd{ nullptr };
+    bool removed{ false };
+    bool script_changed{ false };
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const command& c{ cmds[i] };
+        switch (c.type)
+        {
+        case command_type::create:
+            assert(!create_cmd);
+            create_cmd = &c;
+            break;
+        case command_type::remove:
+            removed = true;
+            break;
+        case command_type::add_script:
+            script_cmd = &c;
+            script_changed = true;
+            break;
+        case command_type::remove_script:
+            script_cmd = nullptr;
+            script_changed = true;
+            break;
+        case command_type::activate:
+        case command_type::deactivate:
+            active_cmd = &c;
+            break;
+        case command_type::make_static:
+        case command_type::make_movable:
+            static_cmd = &c;
+            break;
+        }
+    }
+
+    if (create_cmd)
+    {
+        const entity_id id{ create_cmd->id };
+        generations[id::index(id)] = (id::generation_type)id::generation(id);
+
+        if (removed)
+        {
+            // The entity was never alive, so we just return its id.
+            free_ids.push_back(id);
+            return;
+        }
+
+        transform::init_info transform_info{ create_cmd->transform };
+        script::init_info script_info{ script_changed
+            ? (script_cmd ? script_cmd->script : script::init_info{})
+            : create_cmd->script };
+        [[maybe_unused]] const entity e{ create_components(id, entity_info{ &transform_info, &script_info }) };
+        assert(e.is_valid());
+    }
+    else
+    {
+        const entity_id id{ cmds[0].id };
+        if (!is_alive(id)) return;
+
+        if (removed)
+        {
+            remove_components(id);
+            free_ids.push_back(id);
+            return;
+        }
+
+        if (script_changed) set_script_component(id, script_cmd ? &script_cmd->script : nullptr);
+    }
+
+    const entity_id id{ create_cmd ? create_cmd->id : cmds[0].id };
+    if (active_cmd) set_active_state(id, active_cmd->type == command_type::activate);
+    if (static_cmd) set_static_state(id, static_cmd->type == command_type::make_static);
+}
+
+void
+playback_commands()
+{
+    // Batch allocation of the component slots that were reserved during the phase.
+    if (reserved_slots)
+    {
+        const u64 new_size{ generations.size() + reserved_slots };
+        generations.reserve(new_size);
+        transforms.reserve(new_size);
+        scripts.reserve(new_size);
+        states.reserve(new_size);
+        while (generations.size() < new_size)
+        {
+            generations.push_back(0);
+            transforms.emplace_back();
+            scripts.emplace_back();
+            states.push_back(0);
+        }
+        reserved_slots = 0;
+    }
+
+    utl::vector<command> commands;
+    {
+        std::lock_guard lock{ command_buffers_mutex };
+        u64 count{ 0 };
+        for (auto& buffer : command_buffers) count += buffer->size();
+        if (!count) return;
+
+        commands.reserve(count);
+        for (auto& buffer : command_buffers)
+        {
+            for (auto& c : *buffer) commands.emplace_back(c);
+            buffer->clear();
+        }
+    }
+
+    // Sort by entity slot (and keep the recording order within each slot) so all commands
+    // for one entity can be coalesced and the component arrays are accessed in order.
+    std::sort(commands.begin(), commands.end(), [](const command& a, const command& b)
+              {
+                  const id::id_type index_a{ id::index(a.id) };
+                  const id::id_type index_b{ id::index(b.id) };
+                  return index_a < index_b || (index_a == index_b && a.sequence < b.sequence);
+              });
+
+    const u32 count{ (u32)commands.size() };
+    for (u32 first{ 0 }; first < count;)
+    {
+        const id::id_type index{ id::index(commands[first].id) };
+        u32 last{ first + 1 };
+        while (last < count && id::index(commands[last].id) == index) ++last;
+        apply_commands(&commands[first], last - first);
+        first = last;
+    }
+
+    command_sequence.store(0, std::memory_order_relaxed);
+}
+
+} // anonymous namespace
+
+entity
+create(entity_info info)
+{
+    assert(info.transform); // All game entities must have a transform component
+    if (!info.transform) return entity{};
+
+    if (is_deferring())
+    {
+        const entity_id id{ reserve_id() };
+        record(command_type::create, id, info.transform, info.script);
+        if (recording::is_recording()) recording::detail::record_create(id, info);
+        return entity{ id };
+    }
+
+    entity_id id;
+
+    if (free_ids.size() > id::min_deleted_elements)
+    {
+        id = free_ids.front();
+        assert(!is_alive(id));
+        free_ids.pop_front();
+        id = entity_id{ id::new_generation(id) };
+        ++generations[id::index(id)];
+    }
+    else
+    {
+        id = entity_id{ (id::id_type)generations.size() };
+        generations.push_back(0);
+
+        // Resize components
+        // NOTE: we don't call resize(), so the number of memory allocations stays low
+        transforms.emplace_back();
+        scripts.emplace_back();
+        states.push_back(0);
+    }
+
+    if (recording::is_recording()) recording::detail::record_create(id, info);
+    return create_components(id, info);
+}
+
+void
+remove(entity_id id)
+{
+    if (recording::is_recording()) recording::detail::record_remove(id);
+    if (is_deferring())
+    {
+        record(command_type::remove, id);
+        return;
+    }
+
+    assert(is_alive(id));
+    remove_components(id);
     free_ids.push_back(id);
 }
 
+void
+remove(const entity_id *const ids, u32 count)
+{
+    assert(ids || !count);
+    if (recording::is_recording()) recording::detail::record_remove(ids, count);
+    if (is_deferring())
+    {
+        for (u32 i{ 0 }; i < count; ++i) record(command_type::remove, ids[i]);
+        return;
+    }
+
+    utl::vector<script::component> removed_scripts;
+    removed_scripts.reserve(count);
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const entity_id id{ ids[i] };
+        assert(is_alive(id));
+        const id::id_type index{ id::index(id) };
+        if (scripts[index].is_valid())
+        {
+            removed_scripts.emplace_back(scripts[index]);
+            scripts[index] = {};
+        }
+
+        transform::remove(transforms[index]);
+        transforms[index] = {};
+        event::remove_subscriptions(id);
+        free_ids.push_back(id);
+    }
+
+    script::remove(removed_scripts.data(), (u32)removed_scripts.size());
+    metrics::add(removed_metric, count);
+}
+
+void
+remove_all()
+{
+    assert(!is_deferring());
+    if (recording::is_recording()) recording::detail::record_remove_all();
+    event::remove_entity_subscriptions();
+    script::remove_all();
+    transform::remove_all();
+
+    // NOTE: we keep the generations, so that the ids of removed entities stay invalid
+    //       and the slots can be reused with a new generation.
+    const u32 count{ (u32)generations.size() };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (!transforms[i].is_valid()) continue;
+        free_ids.push_back(entity_id{ id::make_id(i, generations[i]) });
+        transforms[i] = {};
+        scripts[i] = {};
+        metrics::add(removed_metric);
+    }
+}
+
+void
+set_active(entity_id id, bool active)
+{
+    if (recording::is_recording()) recording::detail::record_set_active(id, active);
+    if (is_deferring())
+    {
+        record(active ? command_type::activate : command_type::deactivate, id);
+        return;
+    }
+
+    assert(is_alive(id));
+    set_active_state(id, active);
+}
+
+bool
+is_active(entity_id id)
+{
+    assert(is_alive(id));
+    return !(states[id::index(id)] & state_flags::inactive);
+}
+
+void
+set_static(entity_id id, bool is_static)
+{
+    if (recording::is_recording()) recording::detail::record_set_static(id, is_static);
+    if (is_deferring())
+    {
+        record(is_static ? command_type::make_static : command_type::make_movable, id);
+        return;
+    }
+
+    assert(is_alive(id));
+    set_static_state(id, is_static);
+}
+
+bool
+is_static(entity_id id)
+{
+    assert(is_alive(id));
+    return states[id::index(id)] & state_flags::stationary;
+}
+
 bool
 is_alive(entity_id id)
 {
     assert(id::is_valid(id));
     const id::id_type index{ id::index(id) };
-    assert(index < generations.size());
+    // NOTE: entities created during a deferred phase may have an index beyond the
+    //       current array size. Those entities are not alive until the playback.
+    if (index >= generations.size())
+    {
+        assert(index < generations.size() + reserved_slots);
+        return false;
+    }
     return (generations[index] == id::generation(id) && transforms[index].is_valid());
 }
 
+void
+get_active_entities(utl::vector<entity_id>& ids)
+{
+    const u32 count{ (u32)generations.size() };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (!transforms[i].is_valid() || (states[i] & state_flags::inactive)) continue;
+        ids.emplace_back(id::make_id(i, generations[i]));
+    }
+}
+
+void
+add_script(entity_id id, const script::init_info& info)
+{
+    assert(info.script_creator);
+    if (recording::is_recording()) recording::detail::record_add_script(id, info);
+    if (is_deferring())
+    {
+        record(command_type::add_script, id, nullptr, &info);
+        return;
+    }
+
+    assert(is_alive(id));
+    set_script_component(id, &info);
+}
+
+void
+remove_script(entity_id id)
+{
+    if (recording::is_recording()) recording::detail::record_remove_script(id);
+    if (is_deferring())
+    {
+        record(command_type::remove_script, id);
+        return;
+    }
+
+    assert(is_alive(id));
+    set_script_component(id, nullptr);
+}
+
+void
+begin_deferred_phase()
+{
+    if (recording::is_recording()) recording::detail::record_deferred_phase(true);
+    deferred_phase_depth.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void
+end_deferred_phase()
+{
+    assert(is_deferring());
+    if (recording::is_recording()) recording::detail::record_deferred_phase(false);
+    if (deferred_phase_depth.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        playback_commands();
+    }
+}
+
+bool
+is_deferring()
+{
+    return deferred_phase_depth.load(std::memory_order_acquire) > 0;
+}
+
+u64
+snapshot_size()
+{
+    using namespace snapshot::detail;
+    return array_size(generations) + array_size(free_ids) + array_size(transforms) + array_size(scripts) + array_size(states);
+}
+
+void
+save_snapshot(u8*& at)
+{
+    assert(!is_deferring());
+    using namespace snapshot::detail;
+    write_array(at, generations);
+    write_array(at, free_ids);
+    write_array(at, transforms);
+    write_array(at, scripts);
+    write_array(at, states);
+}
+
+void
+restore_snapshot(const u8*& at)
+{
+    assert(!is_deferring() && !reserved_slots);
+    using namespace snapshot::detail;
+    read_array(at, generations);
+    read_array(at, free_ids);
+    read_array(at, transforms);
+    read_array(at, scripts);
+    read_array(at, states);
+    assert(transforms.size() == generations.size() && scripts.size() == generations.size());
+    assert(states.size() == generations.size());
+}
+
 transform::component
 entity::transform() const
 {
@@ -102,4 +616,28 @@ entity::script() const
     return scripts[index];
 }
 
+void
+entity::set_active(bool active) const
+{
+    game_entity::set_active(_id, active);
+}
+
+bool
+entity::is_active() const
+{
+    return game_entity::is_active(_id);
+}
+
+void
+entity::set_static(bool is_static) const
+{
+    game_entity::set_static(_id, is_static);
+}
+
+bool
+entity::is_static() const
+{
+    return game_entity::is_static(_id);
+}
+
 }
\ No newline at end of file
@@ -19,6 +19,41 @@ struct entity_info
 
 entity create(entity_info info);
 void remove(entity_id id);
+// Removes many entities at once (e.g. when a level is unloaded). Their scripts are
+// destroyed in parallel batches (see script::remove()).
+void remove(const entity_id *const ids, u32 count);
+// Removes all entities. The ids of removed entities stay invalid.
+void remove_all();
 bool is_alive(entity_id id);
+// Appends the ids of all alive and active entities (e.g. the items to render).
+void get_active_entities(utl::vector<entity_id>& ids);
+
+// Adds (or replaces) and removes the script component of an existing entity.
+void add_script(entity_id id, const script::init_info& info);
+void remove_script(entity_id id);
+
+// Inactive entities are skipped by the per-frame updates (i.e. their scripts aren't updated).
+// Static entities can't be moved, so they're never interpolated and their world matrix is
+// computed only once. Like the other structural changes, these are deferred during a deferred phase.
+// NOTE: coroutines of inactive scripts keep running.
+void set_active(entity_id id, bool active);
+bool is_active(entity_id id);
+void set_static(entity_id id, bool is_static);
+bool is_static(entity_id id);
+
+// While a deferred phase is active, structural changes (create, remove, add_script,
+// remove_script, set_active and set_static) are recorded in per-thread command buffers
+// instead of being applied immediately. create() still returns a valid entity, but it won't be alive until the
+// commands are played back. Phases can be nested and the recorded commands are played
+// back in one batch when the outermost phase ends (i.e. at the sync point).
+// NOTE: begin/end_deferred_phase() should only be called from the main thread.
+void begin_deferred_phase();
+void end_deferred_phase();
+bool is_deferring();
+
+// Used by world snapshots (see Snapshot.h).
+u64 snapshot_size();
+void save_snapshot(u8*& at);
+void restore_snapshot(const u8*& at);
 }
 }
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "Event.h"
+#include "..\Core\Metrics.h"
+#include "..\Utilities\Profiler.h"
+#include <algorithm>
+
+namespace primal::event {
+namespace {
+
+// Events of one type that were posted by one thread.
+struct type_buffer
+{
+    utl::vector<u8>                     events;
+    utl::vector<game_entity::entity_id> receivers;
+};
+
+// Each thread has one type buffer per event type.
+// NOTE: the mutex is only contended while the buffer is gathered by dispatch().
+struct thread_buffer
+{
+    std::mutex                  mutex;
+    utl::vector<type_buffer>    types;
+};
+
+struct subscription
+{
+    u32                         type;
+    game_entity::entity_id      receiver;       // invalid for type subscriptions.
+    detail::handler_ptr         handler;        // null if the subscription was removed while dispatching.
+    detail::batch_trampoline    call_batch;
+    detail::entity_trampoline   call_entity;
+    void*                       context;
+    u32                         next;           // next subscription of the same receiver and type.
+};
+
+struct event_type_info
+{
+    u32                                     size;
+    // Events of the current dispatch, sorted by receiver.
+    utl::vector<u8>                         events;
+    utl::vector<game_entity::entity_id>     receivers;
+    utl::vector<u32>                        batch_subscriptions;
+    // First subscription of each receiver. The rest are linked through subscription::next.
+    std::unordered_map<id::id_type, u32>    entity_subscriptions;
+};
+
+struct sort_key
+{
+    u32 receiver;
+    u32 buffer;
+    u32 index;
+};
+
+utl::vector<std::unique_ptr<event_type_info>>   event_types;
+std::mutex                                      event_types_mutex;
+utl::vector<std::unique_ptr<thread_buffer>>     thread_buffers;
+std::mutex                                      thread_buffers_mutex;
+
+utl::vector<subscription>                       subscriptions;
+utl::vector<id::generation_type>                generations;
+utl::deque<subscription_id>                     free_ids;
+// Subscriptions that were removed by handlers. They're freed after the dispatch.
+utl::vector<subscription_id>                    pending_removals;
+utl::vector<sort_key>                           sort_keys;
+bool                                            dispatching{ false };
+
+const metrics::metric_id                        subscriptions_metric{ metrics::register_gauge("events.subscriptions", 0.0,
+                                                    [](void*) { return (f64)(subscriptions.size() - free_ids.size()); }) };
+const metrics::metric_id                        free_ids_metric{ metrics::register_gauge("events.free_ids", 0.0,
+                                                    [](void*) { return (f64)free_ids.size(); }) };
+
+thread_buffer&
+get_thread_buffer()
+{
+    thread_local thread_buffer* buffer{ nullptr };
+    if (!buffer)
+    {
+        std::lock_guard lock{ thread_buffers_mutex };
+        buffer = thread_buffers.emplace_back(std::make_unique<thread_buffer>()).get();
+    }
+
+    return *buffer;
+}
+
+// NOTE: other threads might register event types while we look them up, which reallocates
+//       event_types. The infos themselves don't move.
+event_type_info&
+get_type_info(u32 type)
+{
+    std::lock_guard lock{ event_types_mutex };
+    assert(type < event_types.size());
+    return *event_types[type];
+}
+
+u32
+get_type_count()
+{
+    std::lock_guard lock{ event_types_mutex };
+    return (u32)event_types.size();
+}
+
+bool
+exists(subscription_id id)
+{
+    assert(id::is_valid(id));
+    const id::id_type index{ id::index(id) };
+    assert(index < generations.size());
+    return generations[index] == id::generation(id) && subscriptions[index].handler;
+}
+
+subscription_id
+add_subscription(const subscription& s)
+{
+    subscription_id id{};
+    if (free_ids.size() > id::min_deleted_elements)
+    {
+        id = free_ids.front();
+        assert(!exists(id));
+        free_ids.pop_front();
+        id = subscription_id{ id::new_generation(id) };
+        ++generations[id::index(id)];
+        subscriptions[id::index(id)] = s;
+    }
+    else
+    {
+        id = subscription_id{ (id::id_type)subscriptions.size() };
+        subscriptions.emplace_back(s);
+        generations.push_back(0);
+    }
+
+    return id;
+}
+
+void
+free_subscription(subscription_id id)
+{
+    const u32 index{ id::index(id) };
+    subscription& s{ subscriptions[index] };
+    event_type_info& info{ get_type_info(s.type) };
+
+    if (id::is_valid(s.receiver))
+    {
+        auto it{ info.entity_subscriptions.find(s.receiver) };
+        assert(it != info.entity_subscriptions.end());
+        u32* link{ &it->second };
+        while (*link != index) link = &subscriptions[*link].next;
+        *link = s.next;
+        if (it->second == u32_invalid_id) info.entity_subscriptions.erase(it);
+    }
+    else
+    {
+        // NOTE: we keep the order of the type subscriptions, so handlers are called in
+        //       the order they subscribed.
+        auto& batch{ info.batch_subscriptions };
+        for (u32 i{ 0 }; i < batch.size(); ++i)
+        {
+            if (batch[i] != index) continue;
+            batch.erase(i);
+            break;
+        }
+    }
+
+    s.handler = nullptr;
+    free_ids.push_back(id);
+}
+
+// Copies the events of one type from all thread buffers to a contiguous array sorted by receiver.
+// NOTE: the thread buffers must be locked.
+void
+gather_events(u32 type)
+{
+    event_type_info& info{ get_type_info(type) };
+    info.events.clear();
+    info.receivers.clear();
+
+    const u32 buffer_count{ (u32)thread_buffers.size() };
+    // NOTE: nobody is listening, so we just drop the events.
+    if (info.batch_subscriptions.empty() && info.entity_subscriptions.empty())
+    {
+        for (u32 b{ 0 }; b < buffer_count; ++b)
+        {
+            thread_buffer& buffer{ *thread_buffers[b] };
+            if (type >= buffer.types.size()) continue;
+            buffer.types[type].events.clear();
+            buffer.types[type].receivers.clear();
+        }
+        return;
+    }
+
+    sort_keys.clear();
+    for (u32 b{ 0 }; b < buffer_count; ++b)
+    {
+        const thread_buffer& buffer{ *thread_buffers[b] };
+        if (type >= buffer.types.size()) continue;
+        const auto& receivers{ buffer.types[type].receivers };
+        const u32 count{ (u32)receivers.size() };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            const game_entity::entity_id receiver{ receivers[i] };
+            // NOTE: events without a receiver are sorted last.
+            sort_keys.emplace_back(sort_key{ id::is_valid(receiver) ? id::index(receiver) : u32_invalid_id, b, i });
+        }
+    }
+
+    const u32 count{ (u32)sort_keys.size() };
+    if (!count) return;
+
+    // Sort by receiver, so all events of one entity are delivered together. Events that were
+    // sent to the same receiver stay in the order in which each thread posted them.
+    std::sort(sort_keys.begin(), sort_keys.end(), [](const sort_key& a, const sort_key& b)
+              {
+                  if (a.receiver != b.receiver) return a.receiver < b.receiver;
+                  if (a.buffer != b.buffer) return a.buffer < b.buffer;
+                  return a.index < b.index;
+              });
+
+    const u32 size{ info.size };
+    info.events.resize((u64)count * size);
+    info.receivers.resize(count);
+    u8* at{ info.events.data() };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const sort_key& key{ sort_keys[i] };
+        const type_buffer& source{ thread_buffers[key.buffer]->types[type] };
+        memcpy(at, source.events.data() + (u64)key.index * size, size); at += size;
+        info.receivers[i] = source.receivers[key.index];
+    }
+
+    for (u32 b{ 0 }; b < buffer_count; ++b)
+    {
+        thread_buffer& buffer{ *thread_buffers[b] };
+        if (type >= buffer.types.size()) continue;
+        buffer.types[type].events.clear();
+        buffer.types[type].receivers.clear();
+    }
+}
+
+void
+deliver_events(const event_type_info& info)
+{
+    const u32 count{ (u32)info.receivers.size() };
+    if (!count) return;
+
+    // NOTE: handlers might subscribe or unsubscribe, which can reallocate the subscriptions.
+    //       That's why we look up the subscriptions by index every time.
+    for (u32 i{ 0 }; i < info.batch_subscriptions.size(); ++i)
+    {
+        const subscription& s{ subscriptions[info.batch_subscriptions[i]] };
+        if (s.handler) s.call_batch(s.handler, s.context, info.events.data(), info.receivers.data(), count);
+    }
+
+    if (info.entity_subscriptions.empty()) return;
+
+    for (u32 first{ 0 }; first < count;)
+    {
+        const game_entity::entity_id receiver{ info.receivers[first] };
+        u32 last{ first + 1 };
+        while (last < count && info.receivers[last] == receiver) ++last;
+
+        if (id::is_valid(receiver))
+        {
+            const auto it{ info.entity_subscriptions.find(receiver) };
+            if (it != info.entity_subscriptions.end())
+            {
+                const u32 head{ it->second };
+                for (u32 i{ first }; i < last; ++i)
+                {
+                    const void *const event{ info.events.data() + (u64)i * info.size };
+                    for (u32 index{ head }; index != u32_invalid_id; index = subscriptions[index].next)
+                    {
+                        const subscription& s{ subscriptions[index] };
+                        if (s.handler) s.call_entity(s.handler, s.context, receiver, event);
+                    }
+                }
+            }
+        }
+
+        first = last;
+    }
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+u32
+register_event_type(u32 size)
+{
+    assert(size);
+    std::lock_guard lock{ event_types_mutex };
+    const u32 type{ (u32)event_types.size() };
+    event_type_info& info{ *event_types.emplace_back(std::make_unique<event_type_info>()) };
+    info.size = size;
+    return type;
+}
+
+void
+post(u32 type, u32 size, game_entity::entity_id receiver, const void *const event)
+{
+    assert(event && size);
+    thread_buffer& buffer{ get_thread_buffer() };
+    std::lock_guard lock{ buffer.mutex };
+    if (type >= buffer.types.size()) buffer.types.resize(type + 1);
+
+    type_buffer& b{ buffer.types[type] };
+    const u64 offset{ b.events.size() };
+    // NOTE: resize() only reserves as much as needed, so we grow the buffer by 50% ourselves.
+    if (offset + size > b.events.capacity()) b.events.reserve(((offset + size) * 3) >> 1);
+    b.events.resize(offset + size);
+    memcpy(b.events.data() + offset, event, size);
+    b.receivers.emplace_back(receiver);
+}
+
+subscription_id
+subscribe(u32 type, handler_ptr handler, batch_trampoline trampoline, void* context)
+{
+    assert(handler && trampoline);
+    const subscription_id id{ add_subscription(subscription{ type, game_entity::entity_id{ id::invalid_id },
+                                                             handler, trampoline, nullptr, context, u32_invalid_id }) };
+    get_type_info(type).batch_subscriptions.emplace_back(id::index(id));
+    return id;
+}
+
+subscription_id
+subscribe(u32 type, game_entity::entity_id receiver, handler_ptr handler, entity_trampoline trampoline, void* context)
+{
+    assert(id::is_valid(receiver) && handler && trampoline);
+    const subscription_id id{ add_subscription(subscription{ type, receiver, handler, nullptr, trampoline, context, u32_invalid_id }) };
+
+    // NOTE: new subscriptions are added to the end of the receiver's list,
+    //       so the handlers are called in the order they subscribed.
+    auto& entity_subscriptions{ get_type_info(type).entity_subscriptions };
+    const auto it{ entity_subscriptions.find(receiver) };
+    if (it == entity_subscriptions.end())
+    {
+        entity_subscriptions[receiver] = id::index(id);
+    }
+    else
+    {
+        u32 index{ it->second };
+        while (subscriptions[index].next != u32_invalid_id) index = subscriptions[index].next;
+        subscriptions[index].next = id::index(id);
+    }
+
+    return id;
+}
+
+} // namespace detail
+
+void
+unsubscribe(subscription_id id)
+{
+    assert(exists(id));
+    if (dispatching)
+    {
+        // NOTE: the handler might be in the middle of the list that is being dispatched,
+        //       so we just disable it and free it after the dispatch.
+        subscriptions[id::index(id)].handler = nullptr;
+        pending_removals.emplace_back(id);
+        return;
+    }
+
+    free_subscription(id);
+}
+
+void
+dispatch()
+{
+    PROFILE_SCOPE("event::dispatch");
+    assert(!dispatching);
+    // NOTE: we gather the events of all types before calling any handlers,
+    //       so that events posted by the handlers are delivered in the next dispatch.
+    //       Event types that are registered by the handlers are also dispatched next time.
+    const u32 type_count{ get_type_count() };
+    {
+        std::lock_guard lock{ thread_buffers_mutex };
+        for (const auto& buffer : thread_buffers) buffer->mutex.lock();
+        for (u32 type{ 0 }; type < type_count; ++type) gather_events(type);
+        for (const auto& buffer : thread_buffers) buffer->mutex.unlock();
+    }
+
+    dispatching = true;
+    for (u32 type{ 0 }; type < type_count; ++type) deliver_events(get_type_info(type));
+    dispatching = false;
+
+    for (const subscription_id id : pending_removals) free_subscription(id);
+    pending_removals.clear();
+}
+
+void
+remove_subscriptions(game_entity::entity_id id)
+{
+    assert(id::is_valid(id));
+    const u32 type_count{ get_type_count() };
+    for (u32 type{ 0 }; type < type_count; ++type)
+    {
+        event_type_info& info{ get_type_info(type) };
+        const auto it{ info.entity_subscriptions.find(id) };
+        if (it == info.entity_subscriptions.end()) continue;
+
+        // NOTE: unsubscribe() might remove the entity from the map, so we find the next
+        //       subscription before unsubscribing.
+        u32 index{ it->second };
+        while (index != u32_invalid_id)
+        {
+            const u32 next{ subscriptions[index].next };
+            if (subscriptions[index].handler) unsubscribe(subscription_id{ id::make_id(index, generations[index]) });
+            index = next;
+        }
+    }
+}
+
+void
+remove_entity_subscriptions()
+{
+    utl::vector<subscription_id> ids;
+    const u32 type_count{ get_type_count() };
+    for (u32 type{ 0 }; type < type_count; ++type)
+    {
+        for (const auto& [receiver, head] : get_type_info(type).entity_subscriptions)
+        {
+            for (u32 index{ head }; index != u32_invalid_id; index = subscriptions[index].next)
+            {
+                if (subscriptions[index].handler) ids.emplace_back(id::make_id(index, generations[index]));
+            }
+        }
+    }
+
+    for (const subscription_id id : ids) unsubscribe(id);
+}
+
+}
\ No newline at end of file
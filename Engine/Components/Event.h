@@ -0,0 +1,14 @@
+#pragma once
+#include "ComponentsCommon.h"
+
+namespace primal::event {
+
+// Delivers all events that were posted since the last dispatch (see EventBus.h).
+// NOTE: should only be called from the main thread. Other threads can keep posting events
+//       meanwhile. Those events are delivered either now or in the next dispatch.
+void dispatch();
+
+// Removes the subscriptions of one entity or of all entities (i.e. type subscriptions are kept).
+void remove_subscriptions(game_entity::entity_id id);
+void remove_entity_subscriptions();
+}
\ No newline at end of file
@@ -0,0 +1,516 @@
+#include "Recording.h"
+#include "Transform.h"
+#include "Script.h"
+#include "Snapshot.h"
+#include "..\Core\Mutex.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+
+namespace primal::recording {
+namespace {
+
+constexpr u32 recording_magic{ 0x43455250 }; // "PREC"
+// NOTE: increment this version whenever the layout of an operation changes.
+constexpr u16 recording_version{ 1 };
+
+struct recording_header
+{
+    u32 magic;
+    u16 version;
+    u16 reserved;
+    u64 snapshot_size; // the snapshot follows this header and is followed by the operations.
+};
+
+// Every operation is stored as its type followed by its data. Entity ids are the ids that
+// the entities had while recording. They're mapped to the ids of the replayed entities.
+enum class op_type : u8
+{
+    frame,
+    create,             // id, transform::init_info, u8 has_script [, script_record]
+    remove,             // id
+    remove_many,        // u32 count, count ids
+    remove_all,
+    add_script,         // id, script_record
+    remove_script,      // id
+    activate,           // id
+    deactivate,         // id
+    make_static,        // id
+    make_movable,       // id
+    set_rotation,       // id, v4
+    set_position,       // id, v3
+    set_scale,          // id, v3
+    begin_deferred,
+    end_deferred,
+};
+
+// NOTE: like in snapshots, we store the tag of the script, so that recordings can be
+//       replayed in another process. The creator is only used if the script isn't registered.
+struct script_record
+{
+    u64                             tag;
+    script::detail::script_creator  creator;
+    script::update_rate             rate;
+};
+
+utl::vector<u8>                 stream;
+std::atomic<bool>               recording{ false };
+sync::mutex                     stream_mutex{ "entity recording" };
+thread_local u32                script_depth{ 0 };
+
+// NOTE: the recorder's lock is only taken if the operation is recorded. The flag is
+//       checked again while the lock is taken, because the recording might have ended.
+bool
+should_record()
+{
+    return !script_depth && recording.load(std::memory_order_acquire);
+}
+
+// NOTE: resize() only reserves as much as it needs, so we grow the stream by 50% ourselves.
+void
+write(const void *const data, u64 size)
+{
+    const u64 at{ stream.size() };
+    if (at + size > stream.capacity()) stream.reserve(((at + size) * 3) >> 1);
+    stream.resize(at + size);
+    memcpy(stream.data() + at, data, size);
+}
+
+template<typename T>
+void
+write(const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    write(&value, sizeof(T));
+}
+
+void
+write_op(op_type type, game_entity::entity_id id)
+{
+    write(type);
+    write(id);
+}
+
+script_record
+make_script_record(const script::init_info& info)
+{
+    return script_record{ script::get_tag(info.script_creator), info.script_creator, info.rate };
+}
+
+// Reads the operations of a recording. Reading past the end returns zeros and marks the stream as invalid.
+class stream_reader
+{
+public:
+    stream_reader(const u8* data, u64 size) : _at{ data }, _end{ data + size } {}
+
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value{};
+        if ((u64)(_end - _at) < sizeof(T))
+        {
+            _valid = false;
+            _at = _end;
+            return value;
+        }
+
+        memcpy(&value, _at, sizeof(T));
+        _at += sizeof(T);
+        return value;
+    }
+
+    bool at_end() const { return _at == _end; }
+    bool is_valid() const { return _valid; }
+
+private:
+    const u8*   _at;
+    const u8*   _end;
+    bool        _valid{ true };
+};
+
+class entity_mapping
+{
+public:
+    // Entities that existed when the recording started keep their ids, because they're restored from the snapshot.
+    game_entity::entity_id get(game_entity::entity_id recorded) const
+    {
+        const auto it{ _ids.find((id::id_type)recorded) };
+        return it != _ids.end() ? it->second : recorded;
+    }
+
+    void set(game_entity::entity_id recorded, game_entity::entity_id replayed)
+    {
+        _ids[(id::id_type)recorded] = replayed;
+    }
+
+private:
+    std::unordered_map<id::id_type, game_entity::entity_id> _ids;
+};
+
+u64
+now()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool
+replay_operations(stream_reader& reader, replay_stats& stats, utl::frame_statistics* frame_times)
+{
+    using namespace game_entity;
+    entity_mapping ids;
+    utl::vector<entity_id> removed_ids;
+    u32 deferred_depth{ 0 };
+    const u64 start{ now() };
+    u64 frame_start{ start };
+
+    while (!reader.at_end() && reader.is_valid())
+    {
+        const op_type type{ reader.read<op_type>() };
+        switch (type)
+        {
+        case op_type::frame:
+        {
+            transform::end_step();
+            const u64 frame_end{ now() };
+            const f64 frame_ms{ (frame_end - frame_start) * 1e-6 };
+            if (frame_ms > stats.max_frame_ms) stats.max_frame_ms = frame_ms;
+            if (frame_times) frame_times->record_frame(frame_end - frame_start);
+            frame_start = frame_end;
+            ++stats.frames;
+            continue;
+        }
+        case op_type::create:
+        {
+            const entity_id recorded{ reader.read<entity_id>() };
+            transform::init_info transform_info{ reader.read<transform::init_info>() };
+            const bool has_script{ reader.read<u8>() != 0 };
+            script::init_info script_info{};
+            if (has_script)
+            {
+                const script_record record{ reader.read<script_record>() };
+                script_info.script_creator = record.tag ? script::detail::get_script_creator(record.tag) : record.creator;
+                script_info.rate = record.rate;
+                ++stats.script_changes;
+            }
+
+            if (!reader.is_valid()) break;
+            const entity_info info{ &transform_info, has_script ? &script_info : nullptr };
+            ids.set(recorded, create(info).get_id());
+            ++stats.created;
+        }
+        break;
+        case op_type::remove:
+        {
+            const entity_id id{ ids.get(reader.read<entity_id>()) };
+            if (!reader.is_valid()) break;
+            remove(id);
+            ++stats.removed;
+        }
+        break;
+        case op_type::remove_many:
+        {
+            const u32 count{ reader.read<u32>() };
+            removed_ids.clear();
+            for (u32 i{ 0 }; i < count && reader.is_valid(); ++i) removed_ids.emplace_back(ids.get(reader.read<entity_id>()));
+            if (!reader.is_valid()) break;
+            remove(removed_ids.data(), count);
+            stats.removed += count;
+        }
+        break;
+        case op_type::remove_all:
+            remove_all();
+            break;
+        case op_type::add_script:
+        {
+            const entity_id id{ ids.get(reader.read<entity_id>()) };
+            const script_record record{ reader.read<script_record>() };
+            if (!reader.is_valid()) break;
+            const script::init_info info{ record.tag ? script::detail::get_script_creator(record.tag) : record.creator, record.rate };
+            add_script(id, info);
+            ++stats.script_changes;
+        }
+        break;
+        case op_type::remove_script:
+        case op_type::activate:
+        case op_type::deactivate:
+        case op_type::make_static:
+        case op_type::make_movable:
+        {
+            const entity_id id{ ids.get(reader.read<entity_id>()) };
+            if (!reader.is_valid()) break;
+            if (type == op_type::remove_script) { remove_script(id); ++stats.script_changes; }
+            else if (type == op_type::activate || type == op_type::deactivate) set_active(id, type == op_type::activate);
+            else set_static(id, type == op_type::make_static);
+        }
+        break;
+        case op_type::set_rotation:
+        {
+            const transform::component c{ transform::transform_id{ ids.get(reader.read<entity_id>()) } };
+            const math::v4 rotation{ reader.read<math::v4>() };
+            if (!reader.is_valid()) break;
+            c.set_rotation(rotation);
+            ++stats.transform_writes;
+        }
+        break;
+        case op_type::set_position:
+        case op_type::set_scale:
+        {
+            const transform::component c{ transform::transform_id{ ids.get(reader.read<entity_id>()) } };
+            const math::v3 value{ reader.read<math::v3>() };
+            if (!reader.is_valid()) break;
+            if (type == op_type::set_position) c.set_position(value);
+            else c.set_scale(value);
+            ++stats.transform_writes;
+        }
+        break;
+        case op_type::begin_deferred:
+            begin_deferred_phase();
+            ++deferred_depth;
+            break;
+        case op_type::end_deferred:
+            if (deferred_depth)
+            {
+                end_deferred_phase();
+                --deferred_depth;
+            }
+            break;
+        default:
+            assert(false); // unknown operation
+            while (deferred_depth--) end_deferred_phase();
+            return false;
+        }
+
+        if (reader.is_valid()) ++stats.operations;
+    }
+
+    // NOTE: the recording might have ended in the middle of a deferred phase.
+    while (deferred_depth--) end_deferred_phase();
+    stats.total_ms = (now() - start) * 1e-6;
+    return reader.is_valid();
+}
+
+} // anonymous namespace
+
+void
+begin_recording()
+{
+    // NOTE: the snapshot can't be taken while structural changes are pending.
+    assert(!is_recording() && !game_entity::is_deferring());
+    std::unique_ptr<u8[]> snapshot_data;
+    u64 snapshot_size{ 0 };
+    if (!snapshot::save(snapshot_data, snapshot_size)) return;
+
+    std::lock_guard lock{ stream_mutex };
+    stream.clear();
+    write(recording_header{ recording_magic, recording_version, 0, snapshot_size });
+    write(snapshot_data.get(), snapshot_size);
+    recording.store(true, std::memory_order_release);
+}
+
+bool
+end_recording(std::unique_ptr<u8[]>& data, u64& size)
+{
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return false;
+    recording.store(false, std::memory_order_release);
+
+    size = stream.size();
+    // NOTE: we don't use make_unique here, because it would initialize the buffer with zeros.
+    data = std::unique_ptr<u8[]>{ new u8[size] };
+    memcpy(data.get(), stream.data(), size);
+    stream.clear();
+    return true;
+}
+
+bool
+end_recording(const char* path)
+{
+    assert(path);
+    std::unique_ptr<u8[]> data;
+    u64 size{ 0 };
+    if (!end_recording(data, size)) return false;
+
+    std::ofstream file{ path, std::ios::out | std::ios::binary };
+    if (!file) return false;
+    file.write((const char*)data.get(), size);
+    return file.good();
+}
+
+bool
+is_recording()
+{
+    return recording.load(std::memory_order_acquire);
+}
+
+void
+mark_frame()
+{
+    if (!is_recording()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write(op_type::frame);
+}
+
+bool
+replay(const u8* data, u64 size, replay_stats& stats, utl::frame_statistics* frame_times /* = nullptr */)
+{
+    // NOTE: replayed operations would be recorded again.
+    assert(!is_recording());
+    assert(data && size >= sizeof(recording_header));
+    stats = {};
+    if (!data || size < sizeof(recording_header) || is_recording()) return false;
+
+    recording_header header{};
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != recording_magic || header.version != recording_version ||
+        header.snapshot_size > size - sizeof(header)) return false;
+
+    const u8 *const snapshot_data{ data + sizeof(header) };
+    if (!snapshot::restore(snapshot_data, header.snapshot_size)) return false;
+
+    stream_reader reader{ snapshot_data + header.snapshot_size, size - sizeof(header) - header.snapshot_size };
+    return replay_operations(reader, stats, frame_times);
+}
+
+bool
+replay(const char* path, replay_stats& stats, utl::frame_statistics* frame_times /* = nullptr */)
+{
+    assert(path);
+    std::ifstream file{ path, std::ios::in | std::ios::binary | std::ios::ate };
+    if (!file) return false;
+    const u64 size{ (u64)file.tellg() };
+    file.seekg(0);
+    std::unique_ptr<u8[]> data{ new u8[size] };
+    file.read((char*)data.get(), size);
+    if (!file) return false;
+    return replay(data.get(), size, stats, frame_times);
+}
+
+namespace detail {
+
+void
+record_create(game_entity::entity_id id, const game_entity::entity_info& info)
+{
+    assert(info.transform);
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write_op(op_type::create, id);
+    write(*info.transform);
+    write((u8)(info.script ? 1 : 0));
+    if (info.script) write(make_script_record(*info.script));
+}
+
+void
+record_remove(game_entity::entity_id id)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write_op(op_type::remove, id);
+}
+
+void
+record_remove(const game_entity::entity_id *const ids, u32 count)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write(op_type::remove_many);
+    write(count);
+    write(ids, count * sizeof(game_entity::entity_id));
+}
+
+void
+record_remove_all()
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write(op_type::remove_all);
+}
+
+void
+record_add_script(game_entity::entity_id id, const script::init_info& info)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write_op(op_type::add_script, id);
+    write(make_script_record(info));
+}
+
+void
+record_remove_script(game_entity::entity_id id)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write_op(op_type::remove_script, id);
+}
+
+void
+record_set_active(game_entity::entity_id id, bool active)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write_op(active ? op_type::activate : op_type::deactivate, id);
+}
+
+void
+record_set_static(game_entity::entity_id id, bool is_static)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write_op(is_static ? op_type::make_static : op_type::make_movable, id);
+}
+
+void
+record_set_rotation(game_entity::entity_id id, math::v4 rotation)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write_op(op_type::set_rotation, id);
+    write(rotation);
+}
+
+void
+record_set_position(game_entity::entity_id id, math::v3 position)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write_op(op_type::set_position, id);
+    write(position);
+}
+
+void
+record_set_scale(game_entity::entity_id id, math::v3 scale)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (!recording.load(std::memory_order_relaxed)) return;
+    write_op(op_type::set_scale, id);
+    write(scale);
+}
+
+void
+record_deferred_phase(bool begin)
+{
+    if (!should_record()) return;
+    std::lock_guard lock{ stream_mutex };
+    if (recording.load(std::memory_order_relaxed)) write(begin ? op_type::begin_deferred : op_type::end_deferred);
+}
+
+script_scope::script_scope()
+{
+    ++script_depth;
+}
+
+script_scope::~script_scope()
+{
+    assert(script_depth);
+    --script_depth;
+}
+
+} // namespace detail
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include "Entity.h"
+#include "..\Utilities\FrameStatistics.h"
+
+namespace primal::recording {
+
+// Records entity operations into a compact binary stream, so that a real session can be
+// replayed later (e.g. to benchmark container or allocator changes against the same workload).
+// The recording starts with a snapshot of the world (see Snapshot.h) followed by every
+// game_entity::create/remove, add_script/remove_script, set_active/set_static, transform write
+// and deferred phase, in the order in which they were made. mark_frame() separates the frames.
+// NOTE: operations can be recorded from any thread. Operations that are made concurrently are
+//       recorded in the order in which they took the recorder's lock.
+void begin_recording();
+// Stops recording and returns the recorded stream.
+bool end_recording(std::unique_ptr<u8[]>& data, u64& size);
+// Same as above, but saves the stream to a file.
+bool end_recording(const char* path);
+bool is_recording();
+// Marks the end of a frame. Called by the engine once per frame.
+void mark_frame();
+
+struct replay_stats
+{
+    u64 frames;
+    u64 operations;
+    u64 created;
+    u64 removed;
+    u64 transform_writes;
+    u64 script_changes;     // scripts that were added or removed.
+    f64 total_ms;           // time spent replaying the operations, without restoring the snapshot.
+    f64 max_frame_ms;
+};
+
+// Replaces the current world with the snapshot at the start of the recording and replays all
+// operations headlessly at full speed. transform::end_step() is called at every frame marker.
+// If frame_times isn't null, the time of every replayed frame is recorded in it.
+// NOTE: scripts are created and removed, but not updated, because the changes that they made
+//       are part of the recording. Recordings with scripts that aren't registered can only
+//       be replayed in the same process (see snapshot::restore()).
+bool replay(const u8* data, u64 size, replay_stats& stats, utl::frame_statistics* frame_times = nullptr);
+bool replay(const char* path, replay_stats& stats, utl::frame_statistics* frame_times = nullptr);
+
+namespace detail {
+
+// Called by the entity and transform components while recording.
+void record_create(game_entity::entity_id id, const game_entity::entity_info& info);
+void record_remove(game_entity::entity_id id);
+void record_remove(const game_entity::entity_id *const ids, u32 count);
+void record_remove_all();
+void record_add_script(game_entity::entity_id id, const script::init_info& info);
+void record_remove_script(game_entity::entity_id id);
+void record_set_active(game_entity::entity_id id, bool active);
+void record_set_static(game_entity::entity_id id, bool is_static);
+void record_set_rotation(game_entity::entity_id id, math::v4 rotation);
+void record_set_position(game_entity::entity_id id, math::v3 position);
+void record_set_scale(game_entity::entity_id id, math::v3 scale);
+void record_deferred_phase(bool begin);
+
+// Operations that are made by script constructors and destructors aren't recorded,
+// because they're made again when the scripts are created and removed during replay.
+struct script_scope
+{
+    script_scope();
+    ~script_scope();
+    DISABLE_COPY_AND_MOVE(script_scope);
+};
+
+} // namespace detail
+}
\ No newline at end of file
@@ -1,15 +1,386 @@
 #include "Script.h"
 #include "Entity.h"
+#include "Snapshot.h"
+#include "Event.h"
+#include "Recording.h"
+#include "..\Core\JobSystem.h"
+#include "..\Core\Metrics.h"
+#include "..\Utilities\Profiler.h"
 
 namespace primal::script {
 namespace {
 
+// Update schedule of a script. The schedules are stored in the same order
+// as entity_scripts, so we don't need an extra indirection in update().
+struct schedule
+{
+    u32 frames;     // update every n frames (when interval is 0).
+    u32 phase;      // frame offset that spreads scripts with the same rate across frames.
+    f32 interval;   // if not 0, update every 'interval' seconds.
+    f32 timer;      // time left until the next update (when interval is not 0).
+    f32 dt;         // accumulated time since the last update.
+    detail::task_state* tasks; // coroutines that were started by this script.
+};
+
 utl::vector<detail::script_ptr>     entity_scripts;
+utl::vector<schedule>               schedules;
+utl::vector<detail::script_creator> script_creators;
+utl::vector<script_id>              script_ids;
+// NOTE: scripts of active entities are stored before the scripts of inactive entities,
+//       so update() only iterates over the first active_count scripts.
+u32                                 active_count{ 0 };
 utl::vector<id::id_type>            id_mapping;
 
 utl::vector<id::generation_type>    generations;
 utl::deque<script_id>               free_ids;
 
+// Number of scripts that were assigned to each update rate tier. We use this to
+// give consecutive phases to scripts with the same rate, so that they are evenly
+// distributed across frames and the script update cost doesn't spike.
+std::unordered_map<u64, u32>        rate_tier_counts;
+u32                                 frame_count{ 0 };
+
+// Scripts that update at a fixed interval are spread over this many time slots.
+constexpr u32                       interval_slots{ 16 };
+
+schedule
+make_schedule(update_rate rate, f32 dt = 0.f)
+{
+    schedule s{};
+    s.frames = rate.frames ? rate.frames : 1;
+    s.interval = rate.interval > 0.f ? rate.interval : 0.f;
+    s.dt = dt;
+
+    if (s.interval > 0.f)
+    {
+        u32 bits{ 0 };
+        memcpy(&bits, &s.interval, sizeof(bits));
+        const u32 n{ rate_tier_counts[(1ui64 << 32) | bits]++ };
+        s.timer = s.interval * (f32)((n % interval_slots) + 1) / (f32)interval_slots;
+    }
+    else if (s.frames > 1)
+    {
+        const u32 n{ rate_tier_counts[s.frames]++ };
+        s.phase = n % s.frames;
+    }
+
+    return s;
+}
+
+// Pool allocator for coroutine frames. Frames are rounded up to a power of 2 size class
+// and allocated from 64KB blocks. Freed frames are kept in a free list per size class.
+// Frames that are larger than the largest size class are allocated with malloc.
+class task_frame_pool
+{
+public:
+    task_frame_pool() = default;
+    DISABLE_COPY_AND_MOVE(task_frame_pool);
+    ~task_frame_pool()
+    {
+        for (auto block : _blocks) free(block);
+    }
+
+    [[nodiscard]] void* allocate(size_t size)
+    {
+        const u32 size_class{ get_size_class(size) };
+        if (size_class == size_class_count) return malloc(size);
+
+        std::lock_guard lock{ _mutex };
+        free_node*& head{ _free_nodes[size_class] };
+        if (!head) add_block(size_class);
+        free_node *const node{ head };
+        head = node->next;
+        return node;
+    }
+
+    void deallocate(void* frame, size_t size)
+    {
+        const u32 size_class{ get_size_class(size) };
+        if (size_class == size_class_count)
+        {
+            free(frame);
+            return;
+        }
+
+        std::lock_guard lock{ _mutex };
+        free_node *const node{ (free_node*)frame };
+        node->next = _free_nodes[size_class];
+        _free_nodes[size_class] = node;
+    }
+
+private:
+    struct free_node { free_node* next; };
+
+    constexpr static u32 min_frame_size{ 64 };
+    constexpr static u32 size_class_count{ 6 }; // 64 bytes to 2KB
+    constexpr static u32 block_size{ 64 * 1024 };
+
+    constexpr static u32 get_size_class(size_t size)
+    {
+        u32 size_class{ 0 };
+        while (size_class < size_class_count && ((size_t)min_frame_size << size_class) < size) ++size_class;
+        return size_class;
+    }
+
+    void add_block(u32 size_class)
+    {
+        const u32 frame_size{ min_frame_size << size_class };
+        u8 *const block{ (u8*)malloc(block_size) };
+        assert(block);
+        _blocks.emplace_back(block);
+
+        free_node*& head{ _free_nodes[size_class] };
+        for (u32 i{ block_size / frame_size }; i > 0; --i)
+        {
+            free_node *const node{ (free_node*)(block + (i - 1) * frame_size) };
+            node->next = head;
+            head = node;
+        }
+    }
+
+    free_node*          _free_nodes[size_class_count]{};
+    utl::vector<void*>  _blocks;
+    std::mutex          _mutex;
+};
+
+// Coroutines that wait for a number of seconds are stored in a timer wheel. Each slot
+// covers one tick and timers that are further away than one revolution stay in their
+// slot until their wake time is reached. This way, we only look at the slots of the
+// ticks that passed since the last frame.
+class timer_wheel
+{
+public:
+    void add(detail::task_handle handle, f64 wake_time)
+    {
+        const u64 tick{ (u64)(wake_time / tick_length) };
+        _slots[(tick < _current_tick ? _current_tick : tick) % slot_count].emplace_back(timer{ handle, wake_time });
+    }
+
+    // Moves the handles of all timers that expired at 'time' to 'expired'.
+    void advance(f64 time, utl::vector<detail::task_handle>& expired)
+    {
+        const u64 time_tick{ (u64)(time / tick_length) };
+        // NOTE: after a long frame we'd visit the same slots multiple times, so we stop
+        //       after one revolution.
+        u64 tick{ time_tick - _current_tick >= slot_count ? time_tick - slot_count + 1 : _current_tick };
+        for (; tick <= time_tick; ++tick)
+        {
+            utl::vector<timer>& slot{ _slots[tick % slot_count] };
+            for (u32 i{ 0 }; i < slot.size();)
+            {
+                if (slot[i].wake_time <= time)
+                {
+                    expired.emplace_back(slot[i].handle);
+                    utl::erase_unordered(slot, i);
+                }
+                else ++i;
+            }
+        }
+
+        // NOTE: the slot of the current tick isn't finished yet, so we visit it again next time.
+        _current_tick = time_tick;
+    }
+
+    // Moves the handles of all timers to 'handles'.
+    void clear(utl::vector<detail::task_handle>& handles)
+    {
+        for (utl::vector<timer>& slot : _slots)
+        {
+            for (const timer& t : slot) handles.emplace_back(t.handle);
+            slot.clear();
+        }
+    }
+
+private:
+    struct timer
+    {
+        detail::task_handle handle;
+        f64                 wake_time;
+    };
+
+    constexpr static u32 slot_count{ 256 };
+    constexpr static f64 tick_length{ 1.0 / 64.0 }; // one revolution is 4 seconds.
+
+    utl::vector<timer>  _slots[slot_count];
+    u64                 _current_tick{ 0 };
+};
+
+struct waiting_task
+{
+    detail::task_handle handle;
+    bool(*predicate)(void*);
+    void* data;
+};
+
+task_frame_pool                     task_frames;
+timer_wheel                         task_timers;
+utl::vector<detail::task_handle>    current_frame_tasks;
+utl::vector<detail::task_handle>    next_frame_tasks;
+utl::vector<detail::task_handle>    expired_tasks;
+utl::vector<waiting_task>           waiting_tasks;
+f64                                 task_time{ 0.0 };
+
+const metrics::metric_id            scripts_metric{ metrics::register_gauge("scripts.count", 0.0,
+                                        [](void*) { return (f64)entity_scripts.size(); }) };
+const metrics::metric_id            active_scripts_metric{ metrics::register_gauge("scripts.active", 0.0,
+                                        [](void*) { return (f64)active_count; }) };
+const metrics::metric_id            free_ids_metric{ metrics::register_gauge("scripts.free_ids", 0.0,
+                                        [](void*) { return (f64)free_ids.size(); }) };
+const metrics::metric_id            waiting_tasks_metric{ metrics::register_gauge("scripts.waiting_tasks", 0.0,
+                                        [](void*) { return (f64)waiting_tasks.size(); }) };
+
+void
+unlink_task(detail::task_state& task)
+{
+    if (task.prev)
+    {
+        task.prev->next = task.next;
+    }
+    else
+    {
+        schedule& s{ schedules[id_mapping[id::index(task.owner)]] };
+        assert(s.tasks == &task);
+        s.tasks = task.next;
+    }
+
+    if (task.next) task.next->prev = task.prev;
+    task.prev = task.next = nullptr;
+}
+
+// Cancelled coroutines stay wherever they are waiting and are destroyed when they wake up
+// (or by destroy_cancelled_tasks() when all scripts are removed).
+void
+cancel_tasks(schedule& s)
+{
+    detail::task_state* task{ s.tasks };
+    while (task)
+    {
+        detail::task_state *const next{ task->next };
+        task->cancelled = true;
+        task->prev = task->next = nullptr;
+        task = next;
+    }
+    s.tasks = nullptr;
+}
+
+// Destroys the coroutines that wait to be resumed, instead of waiting until they wake up.
+// NOTE: only call this after all coroutines were cancelled, but before the scripts are destroyed,
+//       because the coroutines' locals might still access their script.
+void
+destroy_cancelled_tasks()
+{
+    task_timers.clear(expired_tasks);
+    for (const waiting_task& w : waiting_tasks) expired_tasks.emplace_back(w.handle);
+    for (auto handle : next_frame_tasks) expired_tasks.emplace_back(handle);
+    waiting_tasks.clear();
+    next_frame_tasks.clear();
+
+    for (auto handle : expired_tasks)
+    {
+        assert(handle.promise().cancelled);
+        handle.destroy();
+    }
+    expired_tasks.clear();
+}
+
+void
+resume_task(detail::task_handle handle)
+{
+    detail::task_promise& promise{ handle.promise() };
+    if (!promise.cancelled)
+    {
+        handle.resume();
+        if (!handle.done()) return;
+        unlink_task(promise);
+    }
+
+    handle.destroy();
+}
+
+void
+run_tasks()
+{
+    // Coroutines that waited for this frame.
+    for (auto handle : current_frame_tasks) resume_task(handle);
+    current_frame_tasks.clear();
+
+    // Coroutines whose timer expired.
+    task_timers.advance(task_time, expired_tasks);
+
+    // Coroutines whose condition became true.
+    for (u32 i{ 0 }; i < waiting_tasks.size();)
+    {
+        const waiting_task& w{ waiting_tasks[i] };
+        // NOTE: the predicate might reference the script that was removed,
+        //       so we don't evaluate it for cancelled coroutines.
+        if (w.handle.promise().cancelled || w.predicate(w.data))
+        {
+            expired_tasks.emplace_back(w.handle);
+            utl::erase_unordered(waiting_tasks, i);
+        }
+        else ++i;
+    }
+
+    // NOTE: resumed coroutines might wait again, so we resume them after we're done
+    //       with the timer wheel and the waiting list.
+    for (auto handle : expired_tasks) resume_task(handle);
+    expired_tasks.clear();
+}
+
+// Swaps two scripts in the dense arrays and fixes their id mapping.
+void
+swap_scripts(u32 a, u32 b)
+{
+    if (a == b) return;
+    std::swap(entity_scripts[a], entity_scripts[b]);
+    std::swap(schedules[a], schedules[b]);
+    std::swap(script_creators[a], script_creators[b]);
+    std::swap(script_ids[a], script_ids[b]);
+    id_mapping[id::index(script_ids[a])] = a;
+    id_mapping[id::index(script_ids[b])] = b;
+}
+
+// Destroys the scripts at the dense indices returned by get_index(0..count-1) in parallel batches.
+// When a level is unloaded, destroying scripts one by one on the main thread would block it for
+// a long time, because every script is a separate heap allocation with its own destructor.
+template<typename index_func>
+void
+destroy_scripts(u32 count, index_func get_index)
+{
+    constexpr u32 batch_size{ 1024 };
+    jobs::parallel_for(count, batch_size, [&get_index](u32 begin, u32 end)
+                       {
+                           // NOTE: the recording scope is per thread, so every batch opens its own.
+                           const recording::detail::script_scope recording_scope{};
+                           for (u32 i{ begin }; i < end; ++i) entity_scripts[get_index(i)].reset();
+                       });
+}
+
+// Snapshot record of a script instance. It's followed by state_size bytes of script state.
+struct script_record
+{
+    u64                     tag;            // hash of the script's name, or 0 if it isn't registered.
+    detail::script_creator  creator;        // only valid in the process that took the snapshot.
+    game_entity::entity_id  entity_id;
+    u32                     state_size;
+};
+
+bool
+is_due(schedule& s, f32 dt)
+{
+    if (s.interval > 0.f)
+    {
+        s.timer -= dt;
+        if (s.timer > 0.f) return false;
+        // NOTE: we don't try to catch up if we missed more than one interval.
+        s.timer += s.interval;
+        if (s.timer < 0.f) s.timer = 0.f;
+        return true;
+    }
+
+    return s.frames == 1 || ((frame_count + s.phase) % s.frames) == 0;
+}
+
 using script_registry = std::unordered_map<size_t, detail::script_creator>;
 script_registry&
 registry()
@@ -38,9 +409,11 @@ exists(script_id id)
 {
     assert(id::is_valid(id));
     const id::id_type index{ id::index(id) };
-    assert(index < generations.size() && id_mapping[index] < entity_scripts.size());
-    assert(generations[index] == id::generation(id));
+    assert(index < generations.size());
+    // NOTE: removed scripts keep their generation until their id is reused,
+    //       so we also have to check whether the id is still mapped.
     return (generations[index] == id::generation(id)) &&
+        id::is_valid(id_mapping[index]) &&
         entity_scripts[id_mapping[index]] &&
         entity_scripts[id_mapping[index]]->is_valid();
 }
@@ -73,6 +446,52 @@ add_script_name(const char* name)
 }
 #endif // USE_WITH_EDITOR
 
+void*
+allocate_task_frame(size_t size)
+{
+    return task_frames.allocate(size);
+}
+
+void
+free_task_frame(void* frame, size_t size)
+{
+    task_frames.deallocate(frame, size);
+}
+
+void
+start_task(task&& t, const game_entity::entity& owner)
+{
+    assert(t.is_valid());
+    const script_id id{ owner.script().get_id() };
+    assert(exists(id));
+    const task_handle handle{ t.release() };
+    task_promise& promise{ handle.promise() };
+    schedule& s{ schedules[id_mapping[id::index(id)]] };
+    promise.owner = id;
+    promise.next = s.tasks;
+    if (s.tasks) s.tasks->prev = &promise;
+    s.tasks = &promise;
+    resume_task(handle);
+}
+
+void
+resume_next_frame(task_handle handle)
+{
+    next_frame_tasks.emplace_back(handle);
+}
+
+void
+resume_after(task_handle handle, f32 seconds)
+{
+    task_timers.add(handle, task_time + seconds);
+}
+
+void
+resume_when(task_handle handle, bool(*predicate)(void*), void* data)
+{
+    waiting_tasks.emplace_back(waiting_task{ handle, predicate, data });
+}
+
 } // namespace detail
 
 component
@@ -80,6 +499,7 @@ create(init_info info, game_entity::entity entity)
 {
     assert(entity.is_valid());
     assert(info.script_creator);
+    const recording::detail::script_scope recording_scope{};
 
     script_id id{};
     if (free_ids.size() > id::min_deleted_elements)
@@ -100,30 +520,298 @@ create(init_info info, game_entity::entity entity)
     assert(id::is_valid(id));
     const id::id_type index{ (id::id_type)entity_scripts.size() };
     entity_scripts.emplace_back(info.script_creator(entity));
+    schedules.emplace_back(make_schedule(info.rate));
+    script_creators.emplace_back(info.script_creator);
+    script_ids.emplace_back(id);
     assert(entity_scripts.back()->get_id() == entity.get_id());
     id_mapping[id::index(id)] = index;
+
+    // New scripts are active, so we move them to the end of the active range.
+    swap_scripts(active_count, index);
+    ++active_count;
     return component{ id };
 }
 
+void
+begin_play(component c)
+{
+    assert(c.is_valid() && exists(c.get_id()));
+    entity_scripts[id_mapping[id::index(c.get_id())]]->begin_play();
+}
+
 void
 remove(component c)
 {
     assert(c.is_valid() && exists(c.get_id()));
+    const recording::detail::script_scope recording_scope{};
     const script_id id{ c.get_id() };
-    const id::id_type index{ id_mapping[id::index(id)] };
-    const script_id last_id{ entity_scripts.back()->script().get_id() };
-    utl::erase_unordered(entity_scripts, index);
-    id_mapping[id::index(last_id)] = index;
+    u32 index{ id_mapping[id::index(id)] };
+    cancel_tasks(schedules[index]);
+    event::remove_subscriptions(entity_scripts[index]->get_id());
+
+    // Keep the active scripts at the front: move the script to the end of the active
+    // range first, and from there to the end of the arrays.
+    if (index < active_count)
+    {
+        --active_count;
+        swap_scripts(index, active_count);
+        index = active_count;
+    }
+
+    const u32 last{ (u32)entity_scripts.size() - 1 };
+    swap_scripts(index, last);
+    utl::erase_unordered(entity_scripts, last);
+    utl::erase_unordered(schedules, last);
+    utl::erase_unordered(script_creators, last);
+    utl::erase_unordered(script_ids, last);
     id_mapping[id::index(id)] = id::invalid_id;
+    free_ids.push_back(id);
+}
+
+void
+remove(const component *const components, u32 count)
+{
+    assert(components || !count);
+    if (!count) return;
+
+    utl::vector<id::id_type> indices;
+    indices.reserve(count);
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const script_id id{ components[i].get_id() };
+        assert(components[i].is_valid() && exists(id));
+        const id::id_type index{ id_mapping[id::index(id)] };
+        cancel_tasks(schedules[index]);
+        indices.emplace_back(index);
+        id_mapping[id::index(id)] = id::invalid_id;
+        free_ids.push_back(id);
+    }
+
+    destroy_scripts(count, [&indices](u32 i) { return indices[i]; });
+
+    // Move the remaining scripts to the front and fix their id mapping.
+    // NOTE: this keeps the order of the scripts, so active scripts stay in front.
+    const u32 size{ (u32)entity_scripts.size() };
+    u32 last{ 0 };
+    u32 remaining_active{ 0 };
+    for (u32 i{ 0 }; i < size; ++i)
+    {
+        if (!entity_scripts[i]) continue;
+        if (i < active_count) ++remaining_active;
+        if (i != last)
+        {
+            entity_scripts[last] = std::move(entity_scripts[i]);
+            schedules[last] = schedules[i];
+            script_creators[last] = script_creators[i];
+            script_ids[last] = script_ids[i];
+            id_mapping[id::index(script_ids[last])] = last;
+        }
+        ++last;
+    }
+
+    entity_scripts.resize(last);
+    schedules.resize(last);
+    script_creators.resize(last);
+    script_ids.resize(last);
+    active_count = remaining_active;
+}
+
+void
+remove_all()
+{
+    for (auto& s : schedules) cancel_tasks(s);
+    destroy_cancelled_tasks();
+    destroy_scripts((u32)entity_scripts.size(), [](u32 i) { return i; });
+    entity_scripts.clear();
+    schedules.clear();
+    script_creators.clear();
+    script_ids.clear();
+    active_count = 0;
+    rate_tier_counts.clear();
+
+    // Rebuild the free-id queue in a single pass over the id mapping.
+    const u32 count{ (u32)id_mapping.size() };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (!id::is_valid(id_mapping[i])) continue;
+        free_ids.push_back(script_id{ id::make_id(i, generations[i]) });
+        id_mapping[i] = id::invalid_id;
+    }
+}
+
+void
+set_active(component c, bool active)
+{
+    assert(c.is_valid() && exists(c.get_id()));
+    const u32 index{ id_mapping[id::index(c.get_id())] };
+    if (active == (index < active_count)) return;
+
+    if (active)
+    {
+        swap_scripts(index, active_count);
+        ++active_count;
+    }
+    else
+    {
+        --active_count;
+        swap_scripts(index, active_count);
+    }
 }
 
 void
 update(float dt)
 {
-    for (auto& ptr : entity_scripts)
+    PROFILE_SCOPE("script::update");
+    // NOTE: scripts can create and remove entities (and thereby scripts) in their
+    //       update function. Those changes are deferred until all scripts are updated,
+    //       so that entity_scripts isn't modified while we're iterating over it.
+    game_entity::begin_deferred_phase();
+    // NOTE: coroutines that wait for the next frame while we run this frame's
+    //       scripts and coroutines are added to next_frame_tasks.
+    current_frame_tasks.swap(next_frame_tasks);
+    task_time += dt;
+
+    const u32 count{ active_count };
+    for (u32 i{ 0 }; i < count; ++i)
     {
-        ptr->update(dt);
+        schedule& s{ schedules[i] };
+        s.dt += dt;
+        if (is_due(s, dt))
+        {
+            entity_scripts[i]->update(s.dt);
+            s.dt = 0.f;
+        }
     }
+
+    {
+        PROFILE_SCOPE("coroutines");
+        run_tasks();
+    }
+    // NOTE: events are dispatched inside the deferred phase, so handlers can
+    //       create and remove entities just like the scripts.
+    event::dispatch();
+    game_entity::end_deferred_phase();
+    ++frame_count;
+}
+
+u64
+snapshot_size()
+{
+    using namespace snapshot::detail;
+    u64 size{ array_size(id_mapping) + array_size(generations) + array_size(free_ids) +
+              array_size(schedules) + array_size(script_ids) + sizeof(u32) + sizeof(u64) };
+    for (auto& ptr : entity_scripts) size += sizeof(script_record) + ptr->state_size();
+    return size;
+}
+
+void
+save_snapshot(u8*& at)
+{
+    using namespace snapshot::detail;
+    write_array(at, id_mapping);
+    write_array(at, generations);
+    write_array(at, free_ids);
+    write_array(at, schedules);
+    write_array(at, script_ids);
+    memcpy(at, &active_count, sizeof(u32)); at += sizeof(u32);
+
+    // NOTE: we store the tag of each script rather than its creator, so that snapshots
+    //       can be restored in another process (e.g. save games).
+    std::unordered_map<detail::script_creator, size_t> tags;
+    for (const auto& [tag, creator] : registry()) tags[creator] = tag;
+
+    const u64 count{ entity_scripts.size() };
+    memcpy(at, &count, sizeof(u64)); at += sizeof(u64);
+    for (u64 i{ 0 }; i < count; ++i)
+    {
+        const detail::script_ptr& script{ entity_scripts[i] };
+        const auto tag{ tags.find(script_creators[i]) };
+        const script_record record
+        {
+            tag != tags.end() ? tag->second : 0,
+            script_creators[i],
+            script->get_id(),
+            script->state_size()
+        };
+
+        memcpy(at, &record, sizeof(record)); at += sizeof(record);
+        script->save_state(at); at += record.state_size;
+    }
+}
+
+void
+begin_restore_snapshot()
+{
+    // NOTE: restoring a snapshot removes all current scripts, which also cancels
+    //       their coroutines and removes their event subscriptions.
+    for (auto& s : schedules) cancel_tasks(s);
+    destroy_cancelled_tasks();
+    event::remove_entity_subscriptions();
+    destroy_scripts((u32)entity_scripts.size(), [](u32 i) { return i; });
+    entity_scripts.clear();
+    script_creators.clear();
+}
+
+void
+restore_snapshot(const u8*& at)
+{
+    assert(entity_scripts.empty());
+
+    using namespace snapshot::detail;
+    read_array(at, id_mapping);
+    read_array(at, generations);
+    read_array(at, free_ids);
+    read_array(at, schedules);
+    read_array(at, script_ids);
+    memcpy(&active_count, at, sizeof(u32)); at += sizeof(u32);
+    for (auto& s : schedules) s.tasks = nullptr;
+
+    u64 count{ 0 };
+    memcpy(&count, at, sizeof(u64)); at += sizeof(u64);
+    assert(count == schedules.size());
+    entity_scripts.reserve(count);
+    script_creators.reserve(count);
+    for (u64 i{ 0 }; i < count; ++i)
+    {
+        script_record record{};
+        memcpy(&record, at, sizeof(record)); at += sizeof(record);
+        const detail::script_creator creator{ record.tag ? detail::get_script_creator(record.tag) : record.creator };
+        assert(creator);
+        entity_scripts.emplace_back(creator(game_entity::entity{ record.entity_id }));
+        script_creators.emplace_back(creator);
+        if (record.state_size) entity_scripts.back()->restore_state(at);
+        at += record.state_size;
+    }
+}
+
+u64
+get_tag(detail::script_creator creator)
+{
+    for (const auto& [tag, func] : registry())
+    {
+        if (func == creator) return tag;
+    }
+
+    return 0;
+}
+
+void
+component::set_update_rate(update_rate rate) const
+{
+    assert(is_valid() && exists(_id));
+    schedule& s{ schedules[id_mapping[id::index(_id)]] };
+    // NOTE: the coroutines that this script started keep running at the new rate.
+    detail::task_state* const tasks{ s.tasks };
+    s = make_schedule(rate, s.dt);
+    s.tasks = tasks;
+}
+
+update_rate
+component::get_update_rate() const
+{
+    assert(is_valid() && exists(_id));
+    const schedule& s{ schedules[id_mapping[id::index(_id)]] };
+    return { s.frames, s.interval };
 }
 }
 
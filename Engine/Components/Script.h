@@ -6,10 +6,32 @@ namespace primal::script {
 struct init_info
 {
     detail::script_creator script_creator;
+    update_rate rate{};
 };
 
 component create(init_info info, game_entity::entity entity);
+// Calls entity_script::begin_play(). The script component must be linked to its entity first,
+// so that the script can start coroutines.
+void begin_play(component c);
 void remove(component c);
+// Removes many scripts at once. The scripts are destroyed in parallel batches and the
+// remaining scripts are compacted in a single pass.
+// NOTE: script destructors run on worker threads, so they shouldn't create or remove entities.
+void remove(const component *const components, u32 count);
+void remove_all();
+// Scripts of inactive entities are not updated.
+void set_active(component c, bool active);
+// Called once per fixed simulation step. dt is the length of the step in seconds.
 void update(float dt);
 
+// Used by world snapshots (see Snapshot.h).
+u64 snapshot_size();
+void save_snapshot(u8*& at);
+// Destroys the current scripts. It's called before any component is restored, because
+// the scripts' destructors might still access their entity and its transform.
+void begin_restore_snapshot();
+void restore_snapshot(const u8*& at);
+// Used by entity recordings (see Recording.h). Returns 0 if the script creator isn't registered.
+u64 get_tag(detail::script_creator creator);
+
 }
\ No newline at end of file
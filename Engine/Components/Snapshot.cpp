@@ -0,0 +1,80 @@
+#include "Snapshot.h"
+#include "Entity.h"
+#include "Transform.h"
+#include "Script.h"
+
+namespace primal::snapshot {
+namespace {
+
+constexpr u32 snapshot_magic{ 0x504e5350 }; // "PSNP"
+// NOTE: increment this version whenever the layout of any component array changes.
+constexpr u16 snapshot_version{ 3 };
+
+enum snapshot_flags : u16
+{
+    compressed_transforms = 0x01,
+};
+
+struct snapshot_header
+{
+    u32 magic;
+    u16 version;
+    u16 flags;
+    u64 size; // total size of the snapshot, including this header.
+};
+
+} // anonymous namespace
+
+bool
+save(std::unique_ptr<u8[]>& data, u64& size, const transform::codec_settings* transform_compression)
+{
+    // NOTE: we can't take a snapshot while structural changes are pending.
+    assert(!game_entity::is_deferring());
+    if (game_entity::is_deferring()) return false;
+
+    size = sizeof(snapshot_header) +
+        game_entity::snapshot_size() +
+        (transform_compression ? transform::compressed_snapshot_size(*transform_compression) : transform::snapshot_size()) +
+        script::snapshot_size();
+
+    // NOTE: we don't use make_unique here, because it would initialize the buffer with zeros.
+    data = std::unique_ptr<u8[]>{ new u8[size] };
+    u8* at{ data.get() };
+
+    const u16 flags{ (u16)(transform_compression ? snapshot_flags::compressed_transforms : 0) };
+    const snapshot_header header{ snapshot_magic, snapshot_version, flags, size };
+    memcpy(at, &header, sizeof(header)); at += sizeof(header);
+    game_entity::save_snapshot(at);
+    if (transform_compression) transform::save_compressed_snapshot(at, *transform_compression);
+    else transform::save_snapshot(at);
+    script::save_snapshot(at);
+
+    assert(at == data.get() + size);
+    return true;
+}
+
+bool
+restore(const u8* data, u64 size)
+{
+    assert(data && size >= sizeof(snapshot_header));
+    assert(!game_entity::is_deferring());
+    if (!data || size < sizeof(snapshot_header) || game_entity::is_deferring()) return false;
+
+    snapshot_header header{};
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != snapshot_magic || header.version != snapshot_version || header.size != size) return false;
+
+    const u8* at{ data + sizeof(header) };
+    script::begin_restore_snapshot();
+    game_entity::restore_snapshot(at);
+    if (header.flags & snapshot_flags::compressed_transforms) transform::restore_compressed_snapshot(at);
+    else transform::restore_snapshot(at);
+    // NOTE: scripts are restored last, because the scripts' constructors
+    //       might access the entity and its transform.
+    script::restore_snapshot(at);
+
+    assert(at == data + size);
+    return true;
+}
+
+}
\ No newline at end of file
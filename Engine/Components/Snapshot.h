@@ -0,0 +1,95 @@
+#pragma once
+#include "ComponentsCommon.h"
+#include "TransformCodec.h"
+
+namespace primal::snapshot {
+
+// Captures the state of all entities and their components: id generations, free-id queues,
+// component arrays, script schedules and (optionally) script state. Scripts opt in to
+// saving their state by overriding entity_script::state_size/save_state/restore_state.
+// NOTE: coroutines that were started by scripts are not part of a snapshot.
+//       They're cancelled when a snapshot is restored.
+// If transform_compression is not null, the transforms are quantized, which makes the snapshot
+// smaller at the cost of a bounded error in the restored transforms (see TransformCodec.h).
+bool save(std::unique_ptr<u8[]>& data, u64& size, const transform::codec_settings* transform_compression = nullptr);
+
+// Replaces the current world with the one that was captured in the snapshot.
+// NOTE: scripts are recreated using the registered script creators. Snapshots taken
+//       with scripts that aren't registered can only be restored in the same process.
+bool restore(const u8* data, u64 size);
+
+namespace detail {
+
+// Helpers used by the components to write their data to a snapshot.
+// Each array is stored as the number of elements followed by its data,
+// so it can be copied with a single memcpy.
+template<typename T>
+constexpr u64
+array_size(const utl::vector<T>& v)
+{
+    return sizeof(u64) + v.size() * sizeof(T);
+}
+
+template<typename T>
+constexpr u64
+array_size(const utl::deque<T>& q)
+{
+    return sizeof(u64) + q.size() * sizeof(T);
+}
+
+template<typename T>
+void
+write_array(u8*& at, const utl::vector<T>& v)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const u64 count{ v.size() };
+    memcpy(at, &count, sizeof(u64)); at += sizeof(u64);
+    if (count) memcpy(at, v.data(), count * sizeof(T));
+    at += count * sizeof(T);
+}
+
+template<typename T>
+void
+write_array(u8*& at, const utl::deque<T>& q)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const u64 count{ q.size() };
+    memcpy(at, &count, sizeof(u64)); at += sizeof(u64);
+    // NOTE: a deque isn't contiguous, so we have to copy the elements one by one.
+    for (const auto& item : q)
+    {
+        memcpy(at, &item, sizeof(T)); at += sizeof(T);
+    }
+}
+
+template<typename T>
+void
+read_array(const u8*& at, utl::vector<T>& v)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    u64 count{ 0 };
+    memcpy(&count, at, sizeof(u64)); at += sizeof(u64);
+    v.clear();
+    v.resize(count);
+    if (count) memcpy(v.data(), at, count * sizeof(T));
+    at += count * sizeof(T);
+}
+
+template<typename T>
+void
+read_array(const u8*& at, utl::deque<T>& q)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    u64 count{ 0 };
+    memcpy(&count, at, sizeof(u64)); at += sizeof(u64);
+    q.clear();
+    for (u64 i{ 0 }; i < count; ++i)
+    {
+        T item;
+        memcpy(&item, at, sizeof(T)); at += sizeof(T);
+        q.push_back(item);
+    }
+}
+
+} // namespace detail
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Transform.h"
 #include "Entity.h"
+#include "Snapshot.h"
+#include "Recording.h"
 
 namespace primal::transform
 {
@@ -9,6 +11,66 @@ namespace primal::transform
 		utl::vector<math::v3> positions;
 		utl::vector<math::v3> scales;
 
+		// Transforms at the beginning of the current simulation step. These are only
+		// written for entities that moved, which is why we keep a list of moved entities.
+		utl::vector<math::v4> previous_rotations;
+		utl::vector<math::v3> previous_positions;
+		utl::vector<math::v3> previous_scales;
+
+		// Interpolated transforms that are used for rendering.
+		utl::vector<math::v4> render_rotations;
+		utl::vector<math::v3> render_positions;
+		utl::vector<math::v3> render_scales;
+		// NOTE: world matrices are only computed when an entity moves, so
+		//       the world matrices of static entities are computed only once.
+		utl::vector<math::m4x4> render_world;
+
+		utl::vector<u8>			moved_flags;
+		utl::vector<id::id_type>	moved;			// entities that moved during the current step.
+		utl::vector<id::id_type>	interpolated;	// entities that moved during the last completed step.
+
+		// NOTE: nlerp is accurate enough for small angles. We use slerp when the angle between
+		//       the two rotations is larger than ~30 degrees (dot product of the quaternions < cos(15)).
+		constexpr f32 slerp_threshold{ 0.966f };
+
+		void
+			update_world(id::id_type index)
+		{
+			using namespace DirectX;
+			const XMMATRIX world{ XMMatrixAffineTransformation(XMLoadFloat3(&render_scales[index]), XMVectorZero(),
+				XMLoadFloat4(&render_rotations[index]), XMLoadFloat3(&render_positions[index])) };
+			XMStoreFloat4x4(&render_world[index], world);
+		}
+
+		void
+			mark_moved(id::id_type index)
+		{
+			if (moved_flags[index]) return;
+			moved_flags[index] = 1;
+			previous_rotations[index] = rotations[index];
+			previous_positions[index] = positions[index];
+			previous_scales[index] = scales[index];
+			moved.emplace_back(index);
+		}
+
+		void
+			reset_interpolation()
+		{
+			const u64 count{ positions.size() };
+			previous_rotations = rotations;
+			previous_positions = positions;
+			previous_scales = scales;
+			render_rotations = rotations;
+			render_positions = positions;
+			render_scales = scales;
+			render_world.resize(count);
+			for (u32 i{ 0 }; i < count; ++i) update_world(i);
+			moved_flags.clear();
+			moved_flags.resize(count, 0);
+			moved.clear();
+			interpolated.clear();
+		}
+
 	} // anonymous namespace
 
 	component
@@ -25,12 +87,33 @@ namespace primal::transform
 		}
 		else
 		{
-			assert(positions.size() == entity_index);
+			// NOTE: entity slots that were reserved during a deferred phase, but whose creation
+			//       was cancelled, never get a transform. So, we might need to skip a few slots.
+			assert(positions.size() <= entity_index);
+			rotations.resize(entity_index);
+			positions.resize(entity_index);
+			scales.resize(entity_index);
 			rotations.emplace_back(info.rotation);
 			positions.emplace_back(info.position);
 			scales.emplace_back(info.scale);
+
+			const u64 count{ positions.size() };
+			previous_rotations.resize(count);
+			previous_positions.resize(count);
+			previous_scales.resize(count);
+			render_rotations.resize(count);
+			render_positions.resize(count);
+			render_scales.resize(count);
+			render_world.resize(count);
+			moved_flags.resize(count, 0);
 		}
 
+		// NOTE: a new entity doesn't move from its previous slot's transform.
+		previous_rotations[entity_index] = render_rotations[entity_index] = rotations[entity_index];
+		previous_positions[entity_index] = render_positions[entity_index] = positions[entity_index];
+		previous_scales[entity_index] = render_scales[entity_index] = scales[entity_index];
+		update_world(entity_index);
+
 		return component{ transform_id{ entity.get_id() } };
 	}
 
@@ -40,6 +123,115 @@ namespace primal::transform
 		assert(c.is_valid());
 	}
 
+	void
+		remove_all()
+	{
+		rotations.clear();
+		positions.clear();
+		scales.clear();
+		reset_interpolation();
+	}
+
+	void
+		end_step()
+	{
+		// Entities that stopped moving are rendered at their final transform.
+		for (const id::id_type index : interpolated)
+		{
+			if (moved_flags[index]) continue;
+			render_rotations[index] = rotations[index];
+			render_positions[index] = positions[index];
+			render_scales[index] = scales[index];
+			update_world(index);
+		}
+
+		interpolated.swap(moved);
+		moved.clear();
+		for (const id::id_type index : interpolated) moved_flags[index] = 0;
+	}
+
+	void
+		interpolate(f32 alpha)
+	{
+		using namespace DirectX;
+		assert(alpha >= 0.f && alpha <= 1.f);
+		const XMVECTOR t{ XMVectorReplicate(alpha) };
+
+		for (const id::id_type index : interpolated)
+		{
+			XMStoreFloat3(&render_positions[index], XMVectorLerpV(XMLoadFloat3(&previous_positions[index]), XMLoadFloat3(&positions[index]), t));
+			XMStoreFloat3(&render_scales[index], XMVectorLerpV(XMLoadFloat3(&previous_scales[index]), XMLoadFloat3(&scales[index]), t));
+
+			const XMVECTOR q0{ XMLoadFloat4(&previous_rotations[index]) };
+			XMVECTOR q1{ XMLoadFloat4(&rotations[index]) };
+			const f32 cos_theta{ XMVectorGetX(XMVector4Dot(q0, q1)) };
+			// NOTE: q and -q represent the same rotation. We take the shortest path.
+			if (cos_theta < 0.f) q1 = XMVectorNegate(q1);
+			const XMVECTOR q{ (cos_theta < 0.f ? -cos_theta : cos_theta) < slerp_threshold
+				? XMQuaternionSlerpV(q0, q1, t)
+				: XMQuaternionNormalize(XMVectorLerpV(q0, q1, t)) };
+			XMStoreFloat4(&render_rotations[index], q);
+			update_world(index);
+		}
+	}
+
+	render_transforms
+		get_render_transforms()
+	{
+		return { render_rotations.data(), render_positions.data(), render_scales.data(), render_world.data(), (u32)positions.size() };
+	}
+
+	u64
+		snapshot_size()
+	{
+		using namespace snapshot::detail;
+		return array_size(rotations) + array_size(positions) + array_size(scales);
+	}
+
+	void
+		save_snapshot(u8*& at)
+	{
+		using namespace snapshot::detail;
+		write_array(at, rotations);
+		write_array(at, positions);
+		write_array(at, scales);
+	}
+
+	void
+		restore_snapshot(const u8*& at)
+	{
+		using namespace snapshot::detail;
+		read_array(at, rotations);
+		read_array(at, positions);
+		read_array(at, scales);
+		assert(positions.size() == rotations.size() && positions.size() == scales.size());
+		reset_interpolation();
+	}
+
+	u64
+		compressed_snapshot_size(const codec_settings& settings)
+	{
+		return encoded_size(scales.data(), (u32)scales.size(), settings);
+	}
+
+	void
+		save_compressed_snapshot(u8*& at, const codec_settings& settings)
+	{
+		assert(positions.size() == rotations.size() && positions.size() == scales.size());
+		encode(at, rotations.data(), positions.data(), scales.data(), (u32)positions.size(), settings);
+	}
+
+	void
+		restore_compressed_snapshot(const u8*& at)
+	{
+		const u32 count{ encoded_count(at) };
+		rotations.resize(count);
+		positions.resize(count);
+		scales.resize(count);
+		decode(at, rotations.data(), positions.data(), scales.data());
+		reset_interpolation();
+	}
+
 	math::v4
 		component::rotation() const
 	{
@@ -61,5 +253,38 @@ namespace primal::transform
 		return scales[id::index(_id)];
 	}
 
+	void
+		component::set_rotation(math::v4 rotation) const
+	{
+		assert(is_valid());
+		const id::id_type index{ id::index(_id) };
+		assert(!game_entity::is_static(game_entity::entity_id{ _id }));
+		mark_moved(index);
+		rotations[index] = rotation;
+		if (recording::is_recording()) recording::detail::record_set_rotation(game_entity::entity_id{ _id }, rotation);
+	}
+
+	void
+		component::set_position(math::v3 position) const
+	{
+		assert(is_valid());
+		const id::id_type index{ id::index(_id) };
+		assert(!game_entity::is_static(game_entity::entity_id{ _id }));
+		mark_moved(index);
+		positions[index] = position;
+		if (recording::is_recording()) recording::detail::record_set_position(game_entity::entity_id{ _id }, position);
+	}
+
+	void
+		component::set_scale(math::v3 scale) const
+	{
+		assert(is_valid());
+		const id::id_type index{ id::index(_id) };
+		assert(!game_entity::is_static(game_entity::entity_id{ _id }));
+		mark_moved(index);
+		scales[index] = scale;
+		if (recording::is_recording()) recording::detail::record_set_scale(game_entity::entity_id{ _id }, scale);
+	}
+
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "ComponentsCommon.h"
+#include "TransformCodec.h"
 
 namespace primal::transform {
 
@@ -12,4 +13,33 @@ struct init_info
 
 component create(init_info info, game_entity::entity entity);
 void remove(component c);
+void remove_all();
+
+// Interpolation between fixed simulation steps. Transforms that are changed during a step
+// are interpolated from their value at the beginning of the step to their value at the end,
+// so rendering can run at a higher rate than the simulation.
+// - end_step() is called after every simulation step.
+// - interpolate() writes the render transforms for the blend factor alpha in [0, 1].
+// NOTE: only entities that moved during the last step are interpolated.
+struct render_transforms
+{
+    const math::v4*     rotations;
+    const math::v3*     positions;
+    const math::v3*     scales;
+    const math::m4x4*   world;
+    u32                 count;
+};
+
+void end_step();
+void interpolate(f32 alpha);
+render_transforms get_render_transforms();
+
+// Used by world snapshots (see Snapshot.h).
+u64 snapshot_size();
+void save_snapshot(u8*& at);
+void restore_snapshot(const u8*& at);
+// Same as above, but the transforms are quantized (see TransformCodec.h).
+u64 compressed_snapshot_size(const codec_settings& settings);
+void save_compressed_snapshot(u8*& at, const codec_settings& settings);
+void restore_compressed_snapshot(const u8*& at);
 }
\ No newline at end of file
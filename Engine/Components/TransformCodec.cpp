@@ -0,0 +1,290 @@
+#include "TransformCodec.h"
+#include <cmath>
+
+namespace primal::transform {
+namespace {
+
+using namespace DirectX;
+
+constexpr u32 rotation_bits{ 10 };
+constexpr u32 position_bits{ 16 };
+constexpr u32 scale_bits{ 16 };
+constexpr u32 rotation_mask{ (1ui32 << rotation_bits) - 1 };
+constexpr f32 rotation_intervals{ (f32)rotation_mask };
+constexpr f32 position_intervals{ (f32)((1ui32 << position_bits) - 1) };
+constexpr f32 inv_sqrt2{ 0.70710678118654752440f };
+// NOTE: we don't want to divide by zero when all positions are on a plane or a line.
+constexpr f32 min_bounds_extent{ 1e-3f };
+
+struct encoded_header
+{
+    u32         count;
+    u32         non_uniform_count;
+    math::v3    bounds_min;
+    math::v3    bounds_max;
+    f32         scale_min;
+    f32         scale_max;
+};
+
+constexpr u32
+mask_words(u32 count)
+{
+    return (count + 31) >> 5;
+}
+
+bool
+is_uniform(const math::v3& s, f32 tolerance)
+{
+    return std::abs(s.x - s.y) <= tolerance && std::abs(s.x - s.z) <= tolerance;
+}
+
+u32
+count_non_uniform(const math::v3 *const scales, u32 count, f32 tolerance)
+{
+    u32 non_uniform_count{ 0 };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (!is_uniform(scales[i], tolerance)) ++non_uniform_count;
+    }
+
+    return non_uniform_count;
+}
+
+void
+compute_bounds(const math::v3 *const positions, u32 count, math::v3& bounds_min, math::v3& bounds_max)
+{
+    XMVECTOR min{ XMVectorZero() };
+    XMVECTOR max{ XMVectorZero() };
+    if (count)
+    {
+        min = max = XMLoadFloat3(&positions[0]);
+        for (u32 i{ 1 }; i < count; ++i)
+        {
+            const XMVECTOR p{ XMLoadFloat3(&positions[i]) };
+            min = XMVectorMin(min, p);
+            max = XMVectorMax(max, p);
+        }
+    }
+
+    XMStoreFloat3(&bounds_min, min);
+    XMStoreFloat3(&bounds_max, XMVectorMax(max, XMVectorAdd(min, XMVectorReplicate(min_bounds_extent))));
+}
+
+// Smallest-three packing: we drop the largest component and reconstruct it from the unit length.
+// Because q and -q represent the same rotation, we can always make the dropped component positive.
+// The other three components are in [-1/sqrt(2), 1/sqrt(2)].
+u32
+encode_rotation(const math::v4& rotation)
+{
+    const f32* const q{ &rotation.x };
+    // NOTE: we start with w, so a zero quaternion (i.e. not initialized) is decoded as identity.
+    u32 largest{ 3 };
+    for (u32 i{ 0 }; i < 3; ++i)
+    {
+        if (std::abs(q[i]) > std::abs(q[largest])) largest = i;
+    }
+
+    XMVECTOR v{ XMLoadFloat4(&rotation) };
+    if (q[largest] < 0.f) v = XMVectorNegate(v);
+
+    // Move the three smallest components to x, y and z.
+    const u32 i0{ largest == 0 ? 1u : 0u };
+    const u32 i1{ largest <= 1 ? 2u : 1u };
+    const u32 i2{ largest <= 2 ? 3u : 2u };
+    v = XMVectorSwizzle(v, i0, i1, i2, 3);
+
+    // Map [-1/sqrt(2), 1/sqrt(2)] to [0, intervals] and round to the nearest integer.
+    v = XMVectorMultiplyAdd(v, XMVectorReplicate(inv_sqrt2 * rotation_intervals),
+                            XMVectorReplicate(0.5f * rotation_intervals + 0.5f));
+    v = XMVectorClamp(v, XMVectorZero(), XMVectorReplicate(rotation_intervals));
+    XMUINT3 packed;
+    XMStoreUInt3(&packed, v);
+
+    return (largest << (3 * rotation_bits)) | (packed.x << (2 * rotation_bits)) | (packed.y << rotation_bits) | packed.z;
+}
+
+math::v4
+decode_rotation(u32 packed)
+{
+    const u32 largest{ packed >> (3 * rotation_bits) };
+    XMVECTOR v{ XMVectorSet((f32)((packed >> (2 * rotation_bits)) & rotation_mask),
+                            (f32)((packed >> rotation_bits) & rotation_mask),
+                            (f32)(packed & rotation_mask), 0.f) };
+    v = XMVectorMultiplyAdd(v, XMVectorReplicate(2.f * inv_sqrt2 / rotation_intervals), XMVectorReplicate(-inv_sqrt2));
+
+    // Reconstruct the largest component and move it back to its place.
+    const XMVECTOR w{ XMVectorSqrt(XMVectorMax(XMVectorZero(), XMVectorSubtract(XMVectorSplatOne(), XMVector3Dot(v, v)))) };
+    v = XMVectorSelect(v, w, g_XMSelect0001);
+    switch (largest)
+    {
+    case 0: v = XMVectorSwizzle<3, 0, 1, 2>(v); break;
+    case 1: v = XMVectorSwizzle<0, 3, 1, 2>(v); break;
+    case 2: v = XMVectorSwizzle<0, 1, 3, 2>(v); break;
+    default: break;
+    }
+
+    math::v4 rotation;
+    XMStoreFloat4(&rotation, XMQuaternionNormalize(v));
+    return rotation;
+}
+
+template<typename T>
+void
+write(u8*& at, const T& value)
+{
+    memcpy(at, &value, sizeof(T)); at += sizeof(T);
+}
+
+template<typename T>
+T
+read(const u8*& at)
+{
+    T value;
+    memcpy(&value, at, sizeof(T)); at += sizeof(T);
+    return value;
+}
+
+} // anonymous namespace
+
+u64
+encoded_size(const math::v3 *const scales, u32 count, const codec_settings& settings)
+{
+    assert(scales || !count);
+    const u32 non_uniform_count{ count_non_uniform(scales, count, settings.uniform_scale_tolerance) };
+    return sizeof(encoded_header) +
+        count * (sizeof(u32) + 3 * sizeof(u16) + sizeof(u16)) + // rotation + position + uniform scale
+        non_uniform_count * 2 * sizeof(u16) +                  // the other two axes of non-uniform scales
+        mask_words(count) * sizeof(u32);
+}
+
+void
+encode(u8*& at, const math::v4 *const rotations, const math::v3 *const positions,
+       const math::v3 *const scales, u32 count, const codec_settings& settings)
+{
+    assert((rotations && positions && scales) || !count);
+    assert(settings.scale_min < settings.scale_max);
+
+    encoded_header header{};
+    header.count = count;
+    header.non_uniform_count = count_non_uniform(scales, count, settings.uniform_scale_tolerance);
+    header.scale_min = settings.scale_min;
+    header.scale_max = settings.scale_max;
+    if (settings.bounds_min.x < settings.bounds_max.x &&
+        settings.bounds_min.y < settings.bounds_max.y &&
+        settings.bounds_min.z < settings.bounds_max.z)
+    {
+        header.bounds_min = settings.bounds_min;
+        header.bounds_max = settings.bounds_max;
+    }
+    else
+    {
+        compute_bounds(positions, count, header.bounds_min, header.bounds_max);
+    }
+
+    write(at, header);
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        write(at, encode_rotation(rotations[i]));
+    }
+
+    {
+        const XMVECTOR min{ XMLoadFloat3(&header.bounds_min) };
+        const XMVECTOR extent{ XMVectorSubtract(XMLoadFloat3(&header.bounds_max), min) };
+        const XMVECTOR intervals{ XMVectorReplicate(position_intervals) };
+        const XMVECTOR scale{ XMVectorDivide(intervals, extent) };
+        const XMVECTOR half{ XMVectorReplicate(0.5f) };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            XMVECTOR v{ XMLoadFloat3(&positions[i]) };
+            v = XMVectorMultiplyAdd(XMVectorSubtract(v, min), scale, half);
+            v = XMVectorClamp(v, XMVectorZero(), intervals);
+            XMUINT3 packed;
+            XMStoreUInt3(&packed, v);
+            const u16 p[3]{ (u16)packed.x, (u16)packed.y, (u16)packed.z };
+            memcpy(at, p, sizeof(p)); at += sizeof(p);
+        }
+    }
+
+    // One bit per transform that tells whether its scale is non-uniform.
+    u8* const mask{ at };
+    const u32 word_count{ mask_words(count) };
+    memset(mask, 0, word_count * sizeof(u32));
+    at += word_count * sizeof(u32);
+
+    const f32 min{ header.scale_min };
+    const f32 max{ header.scale_max };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const math::v3& s{ scales[i] };
+        write(at, (u16)math::pack_float<scale_bits>(math::clamp(s.x, min, max), min, max));
+        if (!is_uniform(s, settings.uniform_scale_tolerance))
+        {
+            write(at, (u16)math::pack_float<scale_bits>(math::clamp(s.y, min, max), min, max));
+            write(at, (u16)math::pack_float<scale_bits>(math::clamp(s.z, min, max), min, max));
+            u32 word;
+            memcpy(&word, &mask[(i >> 5) * sizeof(u32)], sizeof(u32));
+            word |= 1ui32 << (i & 31);
+            memcpy(&mask[(i >> 5) * sizeof(u32)], &word, sizeof(u32));
+        }
+    }
+}
+
+u32
+encoded_count(const u8 *const data)
+{
+    assert(data);
+    u32 count;
+    memcpy(&count, data + offsetof(encoded_header, count), sizeof(u32));
+    return count;
+}
+
+void
+decode(const u8*& at, math::v4 *const rotations, math::v3 *const positions, math::v3 *const scales)
+{
+    const encoded_header header{ read<encoded_header>(at) };
+    const u32 count{ header.count };
+    assert((rotations && positions && scales) || !count);
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        rotations[i] = decode_rotation(read<u32>(at));
+    }
+
+    {
+        const XMVECTOR min{ XMLoadFloat3(&header.bounds_min) };
+        const XMVECTOR extent{ XMVectorSubtract(XMLoadFloat3(&header.bounds_max), min) };
+        const XMVECTOR scale{ XMVectorDivide(extent, XMVectorReplicate(position_intervals)) };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            u16 p[3];
+            memcpy(p, at, sizeof(p)); at += sizeof(p);
+            const XMVECTOR v{ XMVectorSet((f32)p[0], (f32)p[1], (f32)p[2], 0.f) };
+            XMStoreFloat3(&positions[i], XMVectorMultiplyAdd(v, scale, min));
+        }
+    }
+
+    const u8* const mask{ at };
+    at += mask_words(count) * sizeof(u32);
+
+    const f32 min{ header.scale_min };
+    const f32 max{ header.scale_max };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        u32 word;
+        memcpy(&word, &mask[(i >> 5) * sizeof(u32)], sizeof(u32));
+        math::v3& s{ scales[i] };
+        s.x = math::unpack_to_float<scale_bits>(read<u16>(at), min, max);
+        if (word & (1ui32 << (i & 31)))
+        {
+            s.y = math::unpack_to_float<scale_bits>(read<u16>(at), min, max);
+            s.z = math::unpack_to_float<scale_bits>(read<u16>(at), min, max);
+        }
+        else
+        {
+            s.y = s.z = s.x;
+        }
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include "ComponentsCommon.h"
+
+namespace primal::transform {
+
+// Quantized encoding of transforms, used for compressed snapshots and for streaming world state.
+// - rotations use smallest-three packing: 2 bits for the index of the largest component and
+//   10 bits for each of the other three (32 bits per quaternion, max error ~0.25 degrees).
+// - positions are quantized to 16 bits per axis relative to the bounds of a cell.
+// - scales that are uniform are stored once, otherwise all three axes are stored (16 bits each).
+// This brings a transform down from 40 bytes to ~12 bytes (16 bytes with non-uniform scale).
+struct codec_settings
+{
+    // NOTE: if the bounds are empty (min >= max) they're computed from the encoded positions.
+    //       Positions outside of the bounds are clamped.
+    math::v3    bounds_min{ 0.f, 0.f, 0.f };
+    math::v3    bounds_max{ 0.f, 0.f, 0.f };
+    f32         scale_min{ -16.f };
+    f32         scale_max{ 16.f };
+    f32         uniform_scale_tolerance{ 1e-4f };
+};
+
+// Returns the exact number of bytes that encode() writes for the given transforms.
+u64 encoded_size(const math::v3 *const scales, u32 count, const codec_settings& settings = {});
+void encode(u8*& at, const math::v4 *const rotations, const math::v3 *const positions,
+            const math::v3 *const scales, u32 count, const codec_settings& settings = {});
+
+// Returns the number of transforms in an encoded block.
+u32 encoded_count(const u8 *const data);
+// NOTE: the output arrays must have room for at least encoded_count(at) elements.
+void decode(const u8*& at, math::v4 *const rotations, math::v3 *const positions, math::v3 *const scales);
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "..\Components\Transform.h"
 #include "..\Components\Script.h"
 #include "Graphics\Renderer.h"
+#include "Utilities\Profiler.h"
 
 #if !defined(SHIPPING)
 
@@ -21,17 +22,25 @@ enum component_type
     count
 };
 
+// An entity of game.bin. They're read by read_game() and created by create_game_entities().
+struct entity_record
+{
+    transform::init_info    transform_info{};
+    script::init_info       script_info{};
+    bool                    has_transform{ false };
+};
+
 utl::vector<game_entity::entity> entities;
-transform::init_info transform_info{};
-script::init_info script_info{};
+utl::vector<entity_record> entity_records;
 
 bool
-read_transform(const u8*& data, game_entity::entity_info& info)
+read_transform(const u8*& data, entity_record& record)
 {
     using namespace DirectX;
     f32 rotation[3];
 
-    assert(!info.transform);
+    assert(!record.has_transform);
+    transform::init_info& transform_info{ record.transform_info };
     memcpy(&transform_info.position[0], data, sizeof(transform_info.position)); data += sizeof(transform_info.position);
     memcpy(&rotation[0], data, sizeof(rotation)); data += sizeof(rotation);
     memcpy(&transform_info.scale[0], data, sizeof(transform_info.scale)); data += sizeof(transform_info.scale);
@@ -42,15 +51,15 @@ read_transform(const u8*& data, game_entity::entity_info& info)
     XMStoreFloat4A(&rot_quat, quat);
     memcpy(&transform_info.rotation[0], &rot_quat.x, sizeof(transform_info.rotation));
 
-    info.transform = &transform_info;
+    record.has_transform = true;
 
     return true;
 }
 
 bool
-read_script(const u8*& data, game_entity::entity_info& info)
+read_script(const u8*& data, entity_record& record)
 {
-    assert(!info.script);
+    assert(!record.script_info.script_creator);
     const u32 name_length{ *data }; data += sizeof(u32);
     if (!name_length) return false;
     // if a script name is longer than 255 characters then something is probably
@@ -60,12 +69,11 @@ read_script(const u8*& data, game_entity::entity_info& info)
     memcpy(&script_name[0], data, name_length); data += name_length;
     // make the name a zero-terminated c-string.
     script_name[name_length] = 0;
-    script_info.script_creator = script::detail::get_script_creator(script::detail::string_hash()(script_name));
-    info.script = &script_info;
-    return script_info.script_creator != nullptr;
+    record.script_info.script_creator = script::detail::get_script_creator(script::detail::string_hash()(script_name));
+    return record.script_info.script_creator != nullptr;
 }
 
-using component_reader = bool(*)(const u8*&, game_entity::entity_info&);
+using component_reader = bool(*)(const u8*&, entity_record&);
 component_reader component_readers[]
 {
     read_transform,
@@ -96,9 +104,11 @@ read_file(std::filesystem::path path, std::unique_ptr<u8[]>& data, u64& size)
 } // anonymous namespace
 
 bool
-load_game()
+read_game()
 {
-    // read game.bin and create the entities.
+    PROFILE_SCOPE("content::read_game");
+    // read game.bin. The entities are created later by create_game_entities().
+    entity_records.clear();
     std::unique_ptr<u8[]> game_data{};
     u64 size{ 0 };
     if (!read_file("game.bin", game_data, size)) return false;
@@ -108,9 +118,10 @@ load_game()
     const u32 num_entities{ *at }; at += su32;
     if (!num_entities) return false;
 
+    entity_records.reserve(num_entities);
     for (u32 entity_index{ 0 }; entity_index < num_entities; ++entity_index)
     {
-        game_entity::entity_info info{};
+        entity_record& record{ entity_records.emplace_back() };
         const u32 entity_type{ *at }; at += su32;
         const u32 num_components{ *at }; at += su32;
         if (!num_components) return false;
@@ -119,26 +130,44 @@ load_game()
         {
             const u32 component_type{ *at }; at += su32;
             assert(component_type < component_type::count);
-            if (!component_readers[component_type](at, info)) return false;
+            if (!component_readers[component_type](at, record)) return false;
         }
 
-        assert(info.transform);
+        assert(record.has_transform);
+        if (!record.has_transform) return false;
+    }
+
+    assert(at == game_data.get() + size);
+    return true;
+}
+
+bool
+create_game_entities()
+{
+    PROFILE_SCOPE("content::create_game_entities");
+    for (entity_record& record : entity_records)
+    {
+        game_entity::entity_info info{};
+        info.transform = &record.transform_info;
+        if (record.script_info.script_creator) info.script = &record.script_info;
         game_entity::entity entity{ game_entity::create(info) };
         if (!entity.is_valid()) return false;
         entities.emplace_back(entity);
     }
 
-    assert(at == game_data.get() + size);
+    entity_records.clear();
     return true;
 }
 
 void
 unload_game()
 {
-    for (auto entity : entities)
-    {
-        game_entity::remove(entity.get_id());
-    }
+    PROFILE_SCOPE("content::unload_game");
+    utl::vector<game_entity::entity_id> ids;
+    ids.reserve(entities.size());
+    for (auto entity : entities) ids.emplace_back(entity.get_id());
+    game_entity::remove(ids.data(), (u32)ids.size());
+    entities.clear();
 }
 
 bool
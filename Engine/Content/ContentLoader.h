@@ -2,7 +2,11 @@
 #include "CommonHeaders.h"
 #if !defined(SHIPPING)
 namespace primal::content {
-bool load_game();
+// Reads game.bin without creating any entities, so it can run on any thread.
+bool read_game();
+// Creates the entities that were read by read_game(). The script constructors and begin_play()
+// run on the calling thread, which should be the main thread, because scripts might use the window.
+bool create_game_entities();
 void unload_game();
 
 bool load_engine_shaders(std::unique_ptr<u8[]>& shaders, u64& size);
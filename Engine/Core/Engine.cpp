@@ -1,15 +1,28 @@
 #if !defined(SHIPPING)
+#include "Engine.h"
 #include "..\Content\ContentLoader.h"
+#include "..\Components\Recording.h"
 #include "..\Components\Script.h"
+#include "..\Components\Transform.h"
 #include "..\Platform\PlatformTypes.h"
 #include "..\Platform\Platform.h"
 #include "..\Graphics\Renderer.h"
-#include <thread>
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "Metrics.h"
+#include "Mutex.h"
+#include "RenderThread.h"
+#include "Startup.h"
+#include "TaskGraph.h"
+#include "ThreadPlacement.h"
+#include "..\Utilities\Profiler.h"
 
 using namespace primal;
 namespace {
 
 graphics::render_surface game_window{};
+utl::frame_statistics frame_stats{};
+utl::vector<primal::task_graph::stage_timing> stage_timings;
 
 LRESULT win_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
@@ -36,32 +49,177 @@ LRESULT win_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
     return DefWindowProc(hwnd, msg, wparam, lparam);
 }
 
+// Runs on the render thread.
+void
+render(const primal::render_thread::frame_snapshot&, void*)
+{
+    // Apply the surface changes that other threads posted since the last frame.
+    graphics::process_commands();
+    // NOTE: the renderer doesn't draw any scene items yet.
+    if (game_window.surface.is_valid()) game_window.surface.render();
+}
+
+void
+create_frame_graph()
+{
+    using namespace primal::task_graph;
+    const resource_id scene{ add_resource("scene") };
+    const resource_id render_transforms{ add_resource("render_transforms") };
+
+    // The simulation runs in fixed steps. Scripts might use the window, so they run
+    // on the main thread like before.
+    stage_info simulation{};
+    simulation.name = "simulation";
+    simulation.function = [](void*)
+    {
+        const u32 steps{ primal::frame_pacer::step_count() };
+        const f32 dt{ primal::frame_pacer::fixed_step() };
+        for (u32 i{ 0 }; i < steps; ++i)
+        {
+            primal::script::update(dt);
+            primal::transform::end_step();
+        }
+    };
+    simulation.writes = &scene;
+    simulation.write_count = 1;
+    simulation.flags = stage_flags::main_thread;
+    simulation.budget_ms = 2.f;
+    add_stage(simulation);
+
+    stage_info interpolation{};
+    interpolation.name = "interpolation";
+    interpolation.function = [](void*) { primal::transform::interpolate(primal::frame_pacer::alpha()); };
+    interpolation.reads = &scene;
+    interpolation.read_count = 1;
+    interpolation.writes = &render_transforms;
+    interpolation.write_count = 1;
+    add_stage(interpolation);
+
+    // Copies what the render thread needs, so the next frame's simulation
+    // can run while this frame is being rendered.
+    stage_info extraction{};
+    extraction.name = "render extraction";
+    extraction.function = [](void*) { primal::render_thread::submit_frame(); };
+    const resource_id extraction_reads[]{ scene, render_transforms };
+    extraction.reads = &extraction_reads[0];
+    extraction.read_count = _countof(extraction_reads);
+    extraction.budget_ms = 3.f;
+    add_stage(extraction);
+
+    compile();
+
+    // NOTE: the stage names live until the graph is reset, which is after the last frame.
+    stage_timings.resize(get_timings(nullptr));
+    get_timings(stage_timings.data());
+    for (const stage_timing& timing : stage_timings) frame_stats.add_stage(timing.name);
+}
+
+void
+record_frame_stats()
+{
+    primal::task_graph::get_timings(stage_timings.data());
+    for (u32 i{ 0 }; i < stage_timings.size(); ++i)
+    {
+        frame_stats.set_stage_time(i, (u64)(stage_timings[i].duration_ms * 1e6));
+    }
+    frame_stats.end_frame();
+}
+
 } // anonymous namespace
 
+const utl::frame_statistics&
+engine_frame_statistics()
+{
+    return frame_stats;
+}
+
 bool engine_initialize()
 {
-    if (!primal::content::load_game()) return false;
+    PROFILE_THREAD_NAME("main thread");
+    // NOTE: the placement has to be known before the job system starts its workers.
+    primal::thread_placement::initialize({});
+    primal::thread_placement::apply(primal::thread_placement::thread_role::main);
+#ifdef _DEBUG
+    OutputDebugStringA(primal::thread_placement::report().c_str());
+#endif // _DEBUG
+    primal::jobs::initialize(primal::thread_placement::worker_count());
+
+    // Reading the game, building the frame graph, starting the render thread and creating
+    // the window don't depend on each other, so they run in parallel.
+    using namespace primal::startup;
+    init_graph startup{};
+    task_info read_game{ "read game", [](void*) { return primal::content::read_game(); } };
+    const task_id read_game_id{ startup.add_task(read_game) };
+
+    task_info frame_graph{ "frame graph", [](void*) { create_frame_graph(); return true; } };
+    startup.add_task(frame_graph);
+
+    task_info render_thread{ "render thread", [](void*) { primal::render_thread::initialize({ &render, nullptr }); return true; } };
+    startup.add_task(render_thread);
 
-    platform::window_init_info info
+    task_info window{ "create window", [](void*)
     {
-        &win_proc, nullptr, L"Primal Game" // TODO: get the game name from the loaded game file
-    };
+        platform::window_init_info info
+        {
+            &win_proc, nullptr, L"Primal Game" // TODO: get the game name from the loaded game file
+        };
+
+        game_window.window = platform::create_window(&info);
+        return game_window.window.is_valid();
+    } };
+    // NOTE: the window has to be created on the thread that runs the message loop.
+    window.flags = task_flags::main_thread;
+    const task_id window_id{ startup.add_task(window) };
+
+    // NOTE: the entities are created on the main thread after the window, because
+    //       script constructors and begin_play() might use the window.
+    const task_id entity_dependencies[]{ read_game_id, window_id };
+    task_info entities{ "create entities", [](void*) { return primal::content::create_game_entities(); } };
+    entities.dependencies = &entity_dependencies[0];
+    entities.dependency_count = _countof(entity_dependencies);
+    entities.flags = task_flags::main_thread;
+    startup.add_task(entities);
 
-    game_window.window = platform::create_window(&info);
-    if (!game_window.window.is_valid()) return false;
+    const bool result{ startup.run() };
+#ifdef _DEBUG
+    OutputDebugStringA(primal::startup::report().c_str());
+#endif // _DEBUG
+    if (!result) return false;
 
+    // NOTE: the frame pacer starts timing the first frame, so it's initialized last.
+    primal::frame_pacer::initialize({});
     return true;
 }
 
 void engine_update()
 {
-    primal::script::update(10.f);
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    {
+        PROFILE_SCOPE("engine_update");
+        primal::frame_pacer::begin_frame();
+        primal::task_graph::execute();
+    }
+
+    primal::recording::mark_frame();
+
+    primal::profiler::end_frame();
+    primal::metrics::end_frame();
+    record_frame_stats();
+    primal::frame_pacer::end_frame();
 }
 
 void engine_shutdown()
 {
+    primal::render_thread::shutdown();
+#ifdef _DEBUG
+    // NOTE: the metrics of the last frame show what was still alive before the game was unloaded.
+    OutputDebugStringA(primal::metrics::dump().c_str());
+    OutputDebugStringA(primal::sync::dump().c_str());
+    OutputDebugStringA(frame_stats.to_json().c_str());
+#endif // _DEBUG
     platform::remove_window(game_window.window.get_id());
+    primal::task_graph::reset();
     primal::content::unload_game();
+    primal::frame_pacer::shutdown();
+    primal::jobs::shutdown();
 }
 #endif // !defined(SHIPPING)
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "..\Utilities\FrameStatistics.h"
+
+#if !defined(SHIPPING)
+// Frame times of the engine loop, with the time of every task graph stage.
+// Use save() or to_json() to export them (e.g. for comparing two builds).
+// NOTE: only engine_update() records frames, so the statistics are empty in the editor.
+[[nodiscard]] const primal::utl::frame_statistics& engine_frame_statistics();
+#endif // !defined(SHIPPING)
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "FramePacer.h"
+#include <chrono>
+#include <thread>
+#include <cmath>
+
+#ifdef _WIN64
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // !WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif // _WIN64
+
+namespace primal::frame_pacer {
+namespace {
+
+using clock = std::chrono::steady_clock;
+using seconds = std::chrono::duration<f64>;
+
+init_info           settings{};
+clock::time_point   frame_start{};
+clock::time_point   next_frame{};
+f64                 accumulator{ 0.0 };
+f32                 dt{ 0.f };
+u32                 steps{ 0 };
+bool                initialized{ false };
+
+// Statistics of how much sleeps overshoot, in seconds. They're used to decide when
+// to stop sleeping and start spinning.
+f64                 oversleep_mean{ 0.001 };
+f64                 oversleep_variance{ 0.0 };
+constexpr f64       oversleep_weight{ 0.05 };
+constexpr f64       min_spin_threshold{ 0.00005 };
+constexpr f64       max_spin_threshold{ 0.004 };
+
+frame_stats         stats{};
+constexpr f32       stats_weight{ 0.05f };
+
+#ifdef _WIN64
+HANDLE              timer{ nullptr };
+#endif // _WIN64
+
+f64
+spin_threshold()
+{
+    const f64 threshold{ oversleep_mean + 2.0 * std::sqrt(oversleep_variance) };
+    return threshold < min_spin_threshold ? min_spin_threshold : threshold > max_spin_threshold ? max_spin_threshold : threshold;
+}
+
+void
+sleep_for(f64 duration)
+{
+#ifdef _WIN64
+    // NOTE: the high resolution timer wakes up within about half a millisecond. Without it
+    //       (i.e. before Windows 10 1803) we get the default timer resolution of up to 15.6 ms,
+    //       which makes the spin threshold much larger.
+    if (timer)
+    {
+        LARGE_INTEGER due_time{};
+        due_time.QuadPart = -(LONGLONG)(duration * 10000000.0); // relative time in 100 ns units
+        if (SetWaitableTimerEx(timer, &due_time, 0, nullptr, nullptr, nullptr, 0))
+        {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+#endif // _WIN64
+    std::this_thread::sleep_for(seconds{ duration });
+}
+
+void
+wait_until(clock::time_point deadline)
+{
+    for (;;)
+    {
+        const f64 remaining{ seconds{ deadline - clock::now() }.count() };
+        const f64 threshold{ spin_threshold() };
+        if (remaining <= threshold) break;
+
+        const f64 requested{ remaining - threshold };
+        const clock::time_point start{ clock::now() };
+        sleep_for(requested);
+        const f64 oversleep{ seconds{ clock::now() - start }.count() - requested };
+
+        const f64 delta{ oversleep - oversleep_mean };
+        oversleep_mean += delta * oversleep_weight;
+        oversleep_variance = (1.0 - oversleep_weight) * (oversleep_variance + delta * delta * oversleep_weight);
+    }
+
+    // NOTE: yielding instead of busy-waiting lets other threads run while we spin.
+    while (clock::now() < deadline) std::this_thread::yield();
+}
+
+} // anonymous namespace
+
+void
+initialize(const init_info& info)
+{
+    assert(!initialized);
+    settings = info;
+    assert(settings.fixed_step > 0.f && settings.max_steps_per_frame);
+#ifdef _WIN64
+    timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer) timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+#endif // _WIN64
+
+    frame_start = clock::now();
+    next_frame = frame_start;
+    accumulator = 0.0;
+    dt = 0.f;
+    steps = 0;
+    stats = {};
+    initialized = true;
+}
+
+void
+shutdown()
+{
+    if (!initialized) return;
+#ifdef _WIN64
+    if (timer) CloseHandle(timer);
+    timer = nullptr;
+#endif // _WIN64
+    initialized = false;
+}
+
+void
+set_target_frame_rate(f32 frames_per_second)
+{
+    assert(frames_per_second >= 0.f);
+    settings.target_frame_rate = frames_per_second;
+    next_frame = clock::now();
+}
+
+void
+set_fixed_step(f32 step)
+{
+    assert(step > 0.f);
+    settings.fixed_step = step;
+}
+
+u32
+begin_frame()
+{
+    assert(initialized);
+    const clock::time_point now{ clock::now() };
+    const f64 frame_time{ seconds{ now - frame_start }.count() };
+    frame_start = now;
+    dt = (f32)frame_time;
+
+    const f32 frame_ms{ dt * 1000.f };
+    const f32 delta{ frame_ms - stats.average_ms };
+    stats.frame_ms = frame_ms;
+    stats.average_ms = stats.average_ms > 0.f ? stats.average_ms + delta * stats_weight : frame_ms;
+    stats.jitter_ms = std::sqrt((1.f - stats_weight) * (stats.jitter_ms * stats.jitter_ms + delta * delta * stats_weight));
+
+    const f64 step{ settings.fixed_step };
+    accumulator += frame_time;
+    steps = (u32)(accumulator / step);
+    if (steps > settings.max_steps_per_frame)
+    {
+        // NOTE: the simulation can't keep up (or we were stopped in the debugger),
+        //       so we drop the time that's left instead of trying to catch up.
+        stats.dropped_steps += steps - settings.max_steps_per_frame;
+        steps = settings.max_steps_per_frame;
+        accumulator = std::fmod(accumulator, step);
+    }
+    else
+    {
+        accumulator -= steps * step;
+    }
+
+    return steps;
+}
+
+void
+end_frame()
+{
+    assert(initialized);
+    stats.spin_threshold_ms = (f32)(spin_threshold() * 1000.0);
+    if (settings.target_frame_rate <= 0.f)
+    {
+        stats.wait_ms = 0.f;
+        return;
+    }
+
+    // NOTE: we schedule frames relative to when the last one was due, so small delays don't
+    //       add up. If we're more than a frame late, we start over from now.
+    const auto period{ std::chrono::duration_cast<clock::duration>(seconds{ 1.0 / settings.target_frame_rate }) };
+    const clock::time_point now{ clock::now() };
+    next_frame += period;
+    if (next_frame < now - period) next_frame = now;
+
+    wait_until(next_frame);
+    stats.wait_ms = (f32)(seconds{ clock::now() - now }.count() * 1000.0);
+}
+
+u32
+step_count()
+{
+    return steps;
+}
+
+f32
+fixed_step()
+{
+    return settings.fixed_step;
+}
+
+f32
+alpha()
+{
+    const f32 a{ (f32)(accumulator / settings.fixed_step) };
+    return a < 1.f ? a : 1.f;
+}
+
+f32
+frame_dt()
+{
+    return dt;
+}
+
+frame_stats
+get_stats()
+{
+    return stats;
+}
+
+}
\ No newline at end of file
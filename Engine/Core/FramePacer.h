@@ -0,0 +1,45 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace primal::frame_pacer {
+
+// The simulation runs in fixed steps of real time, independently of the frame rate.
+// Every frame, the real time since the last frame is added to an accumulator and as many
+// fixed steps as fit in it are run. What's left is the interpolation factor for rendering.
+// At the end of the frame, the pacer waits until the next frame is due. It sleeps for most
+// of the wait and only spins for the last part, which is about as long as the sleeps overshoot.
+struct init_info
+{
+    f32 target_frame_rate{ 60.f };      // frames per second. 0 means unlimited.
+    f32 fixed_step{ 1.f / 60.f };       // seconds per simulation step.
+    u32 max_steps_per_frame{ 5 };       // if the simulation falls further behind, the extra time is dropped.
+};
+
+struct frame_stats
+{
+    f32 frame_ms;           // duration of the last frame, including the wait.
+    f32 average_ms;         // moving average of the frame duration.
+    f32 jitter_ms;          // moving standard deviation of the frame duration.
+    f32 wait_ms;            // how long the last frame waited.
+    f32 spin_threshold_ms;  // the part of the wait that is spent spinning.
+    u32 dropped_steps;      // total number of steps that were dropped by the max_steps_per_frame guard.
+};
+
+void initialize(const init_info& info);
+void shutdown();
+void set_target_frame_rate(f32 frames_per_second);
+void set_fixed_step(f32 seconds);
+
+// Measures the real time since the last frame and returns the number of fixed steps to run.
+u32 begin_frame();
+// Waits until the next frame is due.
+void end_frame();
+
+[[nodiscard]] u32 step_count();
+[[nodiscard]] f32 fixed_step();
+// Blend factor in [0, 1] between the last two simulation steps.
+[[nodiscard]] f32 alpha();
+// Real time in seconds since the last frame.
+[[nodiscard]] f32 frame_dt();
+[[nodiscard]] frame_stats get_stats();
+}
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "JobSystem.h"
+#include "ThreadPlacement.h"
+#include "..\Utilities\Profiler.h"
+#include <thread>
+#include <condition_variable>
+
+namespace primal::jobs {
+namespace {
+
+struct queued_job
+{
+    jobs::job   job;
+    counter*    job_counter;
+};
+
+// Chase-Lev work-stealing deque with a fixed capacity. The owner thread pushes and pops jobs
+// at the bottom, while other threads steal jobs from the top.
+// NOTE: jobs are stored by value. A thief copies the job before it tries to take it, which
+//       is safe, because the owner can't overwrite a slot until its job has been taken.
+class job_deque
+{
+public:
+    constexpr static u32 capacity{ 4096 };
+
+    [[nodiscard]] bool push(const queued_job& j)
+    {
+        const s64 b{ _bottom.load(std::memory_order_relaxed) };
+        const s64 t{ _top.load(std::memory_order_acquire) };
+        if (b - t >= capacity) return false;
+        _jobs[b & mask] = j;
+        _bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool pop(queued_job& j)
+    {
+        const s64 b{ _bottom.load(std::memory_order_relaxed) - 1 };
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        s64 t{ _top.load(std::memory_order_relaxed) };
+        if (t > b)
+        {
+            // The deque was empty.
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        j = _jobs[b & mask];
+        if (t == b)
+        {
+            // This is the last job, so we race against the thieves for it.
+            const bool won{ _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) };
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    [[nodiscard]] bool steal(queued_job& j)
+    {
+        s64 t{ _top.load(std::memory_order_acquire) };
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const s64 b{ _bottom.load(std::memory_order_acquire) };
+        if (t >= b) return false;
+
+        const queued_job stolen{ _jobs[t & mask] };
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return false;
+        j = stolen;
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return _top.load(std::memory_order_acquire) >= _bottom.load(std::memory_order_acquire);
+    }
+
+private:
+    constexpr static s64 mask{ capacity - 1 };
+    static_assert((capacity & (capacity - 1)) == 0, "Capacity must be a power of 2.");
+
+    // NOTE: top and bottom are on separate cache lines, because they're written by different threads.
+    alignas(64) std::atomic<s64>    _top{ 0 };
+    alignas(64) std::atomic<s64>    _bottom{ 0 };
+    queued_job                      _jobs[capacity];
+};
+
+// Index 0 is the main thread's deque, the others belong to the workers.
+std::unique_ptr<job_deque[]>        deques;
+std::unique_ptr<std::thread[]>      workers;
+u32                                 deque_count{ 0 };
+std::atomic<bool>                   running{ false };
+
+// Idle workers spin for a while before they go to sleep. Every time jobs are queued, wake_epoch
+// is incremented, so a worker that is about to sleep can tell whether it missed new jobs.
+std::mutex                          sleep_mutex;
+std::condition_variable             wake_condition;
+std::atomic<u64>                    wake_epoch{ 0 };
+std::atomic<u32>                    sleeping_workers{ 0 };
+constexpr u32                       spin_count{ 256 };
+
+thread_local u32                    thread_index{ u32_invalid_id };
+
+void
+execute(const queued_job& j)
+{
+    j.job.function(j.job.data, j.job.begin, j.job.end);
+    if (j.job_counter) j.job_counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Runs one job from this thread's deque or, if it's empty, one that's stolen from another thread.
+bool
+try_run_job(u32 index)
+{
+    assert(index < deque_count);
+    queued_job j;
+    if (deques[index].pop(j))
+    {
+        execute(j);
+        return true;
+    }
+
+    // NOTE: we start stealing from the next thread, so the thieves don't all go after the same deque.
+    for (u32 i{ 1 }; i < deque_count; ++i)
+    {
+        if (deques[(index + i) % deque_count].steal(j))
+        {
+            execute(j);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+wake_workers(u32 count)
+{
+    wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (!sleeping_workers.load(std::memory_order_seq_cst)) return;
+
+    // NOTE: we take the lock, so we can't notify between a worker's check and its wait.
+    { std::lock_guard lock{ sleep_mutex }; }
+    if (count > 1) wake_condition.notify_all();
+    else wake_condition.notify_one();
+}
+
+void
+worker_loop(u32 index)
+{
+    thread_index = index;
+    PROFILE_THREAD_NAME("job worker");
+    thread_placement::apply(thread_placement::thread_role::worker, index - 1);
+    u32 spins{ 0 };
+    while (running.load(std::memory_order_acquire))
+    {
+        const u64 epoch{ wake_epoch.load(std::memory_order_seq_cst) };
+        if (try_run_job(index))
+        {
+            spins = 0;
+            continue;
+        }
+
+        if (++spins < spin_count)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::unique_lock lock{ sleep_mutex };
+            wake_condition.wait(lock, [epoch]()
+                                {
+                                    return wake_epoch.load(std::memory_order_seq_cst) != epoch ||
+                                        !running.load(std::memory_order_acquire);
+                                });
+        }
+        sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+        spins = 0;
+    }
+}
+
+} // anonymous namespace
+
+void
+initialize(u32 worker_count)
+{
+    assert(!running && !deque_count);
+    if (!worker_count)
+    {
+        const u32 cores{ std::thread::hardware_concurrency() };
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+
+    deque_count = worker_count + 1;
+    deques = std::make_unique<job_deque[]>(deque_count);
+    thread_index = 0;
+    running = true;
+
+    workers = std::make_unique<std::thread[]>(worker_count);
+    for (u32 i{ 0 }; i < worker_count; ++i)
+    {
+        workers[i] = std::thread{ worker_loop, i + 1 };
+    }
+}
+
+void
+shutdown()
+{
+    if (!running) return;
+    assert(thread_index == 0);
+
+    // Finish the jobs that are still queued on any thread. try_run_job() also steals from the workers,
+    // but a steal fails when another thread takes the same job, so we keep going until every deque is empty.
+    while (true)
+    {
+        if (try_run_job(0)) continue;
+
+        bool all_empty{ true };
+        for (u32 i{ 0 }; i < deque_count; ++i) all_empty = all_empty && deques[i].empty();
+        if (all_empty) break;
+        std::this_thread::yield();
+    }
+
+    running = false;
+    wake_workers(deque_count);
+    for (u32 i{ 0 }; i + 1 < deque_count; ++i) workers[i].join();
+
+    // NOTE: a job that was still running on a worker could have queued more jobs after the deques were
+    //       checked. The workers are gone now, so the main thread runs those too.
+    while (try_run_job(0)) {}
+
+    workers.reset();
+    deques.reset();
+    deque_count = 0;
+    thread_index = u32_invalid_id;
+}
+
+u32
+thread_count()
+{
+    return deque_count ? deque_count : 1;
+}
+
+void
+run(const job *const jobs, u32 count, counter* job_counter)
+{
+    assert(jobs || !count);
+    if (!count) return;
+    if (job_counter) job_counter->value.fetch_add(count, std::memory_order_acq_rel);
+
+    // NOTE: jobs run immediately when the job system isn't running or when they're
+    //       queued from a thread that doesn't belong to the job system.
+    const u32 index{ thread_index };
+    if (!running.load(std::memory_order_acquire) || index >= deque_count)
+    {
+        for (u32 i{ 0 }; i < count; ++i) execute(queued_job{ jobs[i], job_counter });
+        return;
+    }
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const queued_job j{ jobs[i], job_counter };
+        // NOTE: if the deque is full, we just run the job here.
+        if (!deques[index].push(j)) execute(j);
+    }
+
+    wake_workers(count);
+}
+
+void
+wait(counter& job_counter, bool help)
+{
+    const u32 index{ thread_index };
+    const bool can_help{ help && running.load(std::memory_order_acquire) && index < deque_count };
+    while (!job_counter.is_done())
+    {
+        if (can_help && try_run_job(index)) continue;
+        std::this_thread::yield();
+    }
+}
+
+bool
+run_pending_job()
+{
+    const u32 index{ thread_index };
+    if (!running.load(std::memory_order_acquire) || index >= deque_count) return false;
+    return try_run_job(index);
+}
+
+}
\ No newline at end of file
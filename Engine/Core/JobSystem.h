@@ -0,0 +1,101 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <atomic>
+
+namespace primal::jobs {
+
+// A job runs function(data, begin, end). Jobs are small and trivially copyable, so they can be
+// stored in the work queues by value. The [begin, end) range is used by parallel_for() to split
+// the work, but other jobs can use it for anything they like.
+using job_function = void(*)(void* data, u32 begin, u32 end);
+
+struct job
+{
+    job_function    function{ nullptr };
+    void*           data{ nullptr };
+    u32             begin{ 0 };
+    u32             end{ 0 };
+};
+
+// Counts the jobs that haven't finished yet. Use wait() to wait for them.
+struct counter
+{
+    std::atomic<u32> value{ 0 };
+    [[nodiscard]] bool is_done() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Starts the worker threads. If worker_count is 0, one worker per core (minus the main thread)
+// is started. Until the job system is initialized, all jobs run immediately on the calling thread.
+// NOTE: initialize() must be called from the main thread, which then also runs jobs while it waits.
+void initialize(u32 worker_count = 0);
+void shutdown();
+[[nodiscard]] u32 thread_count();
+
+// Queues the jobs on the calling thread's deque, from where idle workers steal them.
+// If job_counter isn't null, it's incremented by count and decremented when each job finishes.
+void run(const job *const jobs, u32 count, counter* job_counter = nullptr);
+// Waits until all jobs of the counter have finished. If help is true, the calling thread runs
+// queued jobs while it waits (this is required when waiting from inside a job).
+void wait(counter& job_counter, bool help = true);
+// Runs one queued job on the calling thread. Returns false if there was nothing to run.
+// This is for threads that wait for something other than a counter and want to help meanwhile.
+[[nodiscard]] bool run_pending_job();
+
+namespace detail {
+template<typename F>
+void
+call_range_function(void* data, u32 begin, u32 end)
+{
+    (*static_cast<F*>(data))(begin, end);
+}
+} // namespace detail
+
+// Calls f(begin, end) for consecutive ranges of [0, count) in parallel and waits for all of them.
+// Ranges are at least min_batch_size elements long (except the last one).
+template<typename F>
+void
+parallel_for(u32 count, u32 min_batch_size, F&& f)
+{
+    if (!count) return;
+    if (min_batch_size == 0) min_batch_size = 1;
+
+    // NOTE: we create a few jobs per thread, so that threads that finish early can steal work.
+    const u32 max_jobs{ thread_count() * 4 };
+    u32 job_count{ (count + min_batch_size - 1) / min_batch_size };
+    if (job_count > max_jobs) job_count = max_jobs;
+    if (job_count <= 1)
+    {
+        f(0u, count);
+        return;
+    }
+
+    constexpr u32 max_jobs_per_call{ 256 };
+    if (job_count > max_jobs_per_call) job_count = max_jobs_per_call;
+    const u32 batch_size{ (count + job_count - 1) / job_count };
+    job_count = (count + batch_size - 1) / batch_size;
+
+    using function_type = std::remove_reference_t<F>;
+    job batch_jobs[max_jobs_per_call];
+    for (u32 i{ 0 }; i < job_count; ++i)
+    {
+        const u32 begin{ i * batch_size };
+        const u32 end{ begin + batch_size < count ? begin + batch_size : count };
+        batch_jobs[i] = job{ &detail::call_range_function<function_type>, (void*)&f, begin, end };
+    }
+
+    counter c;
+    run(&batch_jobs[0], job_count, &c);
+    wait(c);
+}
+
+// Calls f(item) for every item of the vector in parallel and waits for all of them.
+template<typename T, typename F>
+void
+parallel_for(utl::vector<T>& items, F&& f, u32 min_batch_size = 64)
+{
+    parallel_for((u32)items.size(), min_batch_size, [&items, &f](u32 begin, u32 end)
+                 {
+                     for (u32 i{ begin }; i < end; ++i) f(items[i]);
+                 });
+}
+}
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "Metrics.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace primal::metrics {
+namespace {
+
+// NOTE: the number of metrics is fixed, so that the per-thread slots never move
+//       while other threads are adding to them.
+constexpr u32 max_metrics{ 256 };
+
+// NOTE: metrics never move, so the names can be returned as pointers.
+struct metric
+{
+    std::string         name;
+    u32                 type{ metric_type::counter };
+    sampler             sample{ nullptr };
+    void*               context{ nullptr };
+    std::atomic<f64>    capacity{ 0.0 };
+    // Gauges: the current value. Counters aren't stored here (see thread_counters).
+    std::atomic<f64>    value{ 0.0 };
+};
+
+// Each thread only writes its own slots, so it doesn't need atomic read-modify-write
+// operations. The slots are atomic so that end_frame() can read them at any time.
+struct thread_counters
+{
+    std::atomic<s64>    values[max_metrics]{};
+};
+
+struct registry
+{
+    metric                                          metrics[max_metrics]{};
+    std::atomic<u32>                                count{ 0 };
+    // Guards registration, the samplers and the list of threads.
+    std::mutex                                      mutex;
+    utl::vector<std::unique_ptr<thread_counters>>   threads;
+
+    // Guards the snapshot and the counter totals of the last snapshot.
+    std::mutex                                      snapshot_mutex;
+    utl::vector<metric_value>                       snapshot;
+    s64                                             last_totals[max_metrics]{};
+    f64                                             peaks[max_metrics]{};
+};
+
+// NOTE: metrics are registered during static initialization of other modules,
+//       so the registry is created on first use.
+registry&
+state()
+{
+    static registry r;
+    return r;
+}
+
+thread_counters&
+get_thread_counters()
+{
+    thread_local thread_counters* counters{ nullptr };
+    if (!counters)
+    {
+        registry& r{ state() };
+        std::lock_guard lock{ r.mutex };
+        counters = r.threads.emplace_back(std::make_unique<thread_counters>()).get();
+    }
+
+    return *counters;
+}
+
+metric&
+get_metric(metric_id id)
+{
+    assert(id::is_valid(id) && (u32)id < state().count.load(std::memory_order_acquire));
+    return state().metrics[(u32)id];
+}
+
+metric_id
+register_metric(const char* name, u32 type)
+{
+    assert(name && *name);
+    registry& r{ state() };
+    const u32 count{ r.count.load(std::memory_order_relaxed) };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (r.metrics[i].name == name)
+        {
+            assert(r.metrics[i].type == type);
+            return metric_id{ i };
+        }
+    }
+
+    assert(count < max_metrics);
+    if (count >= max_metrics) return metric_id{ id::invalid_id };
+    r.metrics[count].name = name;
+    r.metrics[count].type = type;
+    r.count.store(count + 1, std::memory_order_release);
+    return metric_id{ count };
+}
+
+void
+copy_snapshot(utl::vector<metric_value>& values)
+{
+    registry& r{ state() };
+    std::lock_guard lock{ r.snapshot_mutex };
+    values = r.snapshot;
+}
+
+void
+json_escape(std::string& text, const char* s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\') text += '\\';
+        if ((u8)*s < 0x20) continue;
+        text += *s;
+    }
+}
+
+} // anonymous namespace
+
+metric_id
+register_counter(const char* name)
+{
+    std::lock_guard lock{ state().mutex };
+    return register_metric(name, metric_type::counter);
+}
+
+metric_id
+register_gauge(const char* name, f64 capacity /* = 0.0 */, sampler sample /* = nullptr */, void* context /* = nullptr */)
+{
+    registry& r{ state() };
+    std::lock_guard lock{ r.mutex };
+    const metric_id id{ register_metric(name, metric_type::gauge) };
+    if (id::is_valid(id))
+    {
+        metric& m{ r.metrics[(u32)id] };
+        m.sample = sample;
+        m.context = context;
+        m.capacity.store(capacity, std::memory_order_relaxed);
+    }
+
+    return id;
+}
+
+void
+remove_sampler(metric_id id)
+{
+    if (!id::is_valid(id)) return;
+    std::lock_guard lock{ state().mutex };
+    metric& m{ get_metric(id) };
+    m.sample = nullptr;
+    m.context = nullptr;
+}
+
+void
+add(metric_id id, s64 value /* = 1 */)
+{
+    if (!id::is_valid(id)) return;
+    assert(get_metric(id).type == metric_type::counter);
+    std::atomic<s64>& slot{ get_thread_counters().values[(u32)id] };
+    slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void
+set(metric_id id, f64 value)
+{
+    if (!id::is_valid(id)) return;
+    metric& m{ get_metric(id) };
+    assert(m.type == metric_type::gauge);
+    m.value.store(value, std::memory_order_relaxed);
+}
+
+void
+set_capacity(metric_id id, f64 capacity)
+{
+    if (!id::is_valid(id)) return;
+    get_metric(id).capacity.store(capacity, std::memory_order_relaxed);
+}
+
+void
+end_frame()
+{
+    registry& r{ state() };
+    s64 totals[max_metrics]{};
+    u32 count{ 0 };
+    {
+        std::lock_guard lock{ r.mutex };
+        count = r.count.load(std::memory_order_relaxed);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            metric& m{ r.metrics[i] };
+            if (m.sample) m.value.store(m.sample(m.context), std::memory_order_relaxed);
+        }
+
+        for (const auto& thread : r.threads)
+        {
+            for (u32 i{ 0 }; i < count; ++i) totals[i] += thread->values[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::lock_guard lock{ r.snapshot_mutex };
+    r.snapshot.resize(count);
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const metric& m{ r.metrics[i] };
+        metric_value& v{ r.snapshot[i] };
+        v.name = m.name.c_str();
+        v.type = m.type;
+        v.capacity = m.capacity.load(std::memory_order_relaxed);
+        if (m.type == metric_type::counter)
+        {
+            v.value = (f64)(totals[i] - r.last_totals[i]);
+            v.total = (f64)totals[i];
+            r.last_totals[i] = totals[i];
+        }
+        else
+        {
+            v.value = m.value.load(std::memory_order_relaxed);
+            if (v.value > r.peaks[i]) r.peaks[i] = v.value;
+            v.total = r.peaks[i];
+        }
+
+        v.near_capacity = v.capacity > 0.0 && v.value >= v.capacity * warning_ratio;
+    }
+}
+
+u32
+get_metrics(metric_value *const values)
+{
+    registry& r{ state() };
+    std::lock_guard lock{ r.snapshot_mutex };
+    const u32 count{ (u32)r.snapshot.size() };
+    if (values) memcpy(values, r.snapshot.data(), count * sizeof(metric_value));
+    return count;
+}
+
+std::string
+dump()
+{
+    utl::vector<metric_value> values;
+    copy_snapshot(values);
+
+    std::string text;
+    char buffer[256];
+    for (const metric_value& v : values)
+    {
+        if (v.type == metric_type::counter)
+        {
+            snprintf(buffer, sizeof(buffer), "  %-40s %12.0f /frame %14.0f total\n", v.name, v.value, v.total);
+        }
+        else if (v.capacity > 0.0)
+        {
+            snprintf(buffer, sizeof(buffer), "%c %-40s %12.0f of %-10.0f %5.1f%% (peak %.0f)\n",
+                     v.near_capacity ? '!' : ' ', v.name, v.value, v.capacity, v.value * 100.0 / v.capacity, v.total);
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "  %-40s %12.0f (peak %.0f)\n", v.name, v.value, v.total);
+        }
+        text += buffer;
+    }
+
+    return text;
+}
+
+std::string
+dump_json()
+{
+    utl::vector<metric_value> values;
+    copy_snapshot(values);
+    const u32 count{ (u32)values.size() };
+
+    std::string text{ "[\n" };
+    char buffer[192];
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const metric_value& v{ values[i] };
+        text += i ? ",\n{\"name\":\"" : "{\"name\":\"";
+        json_escape(text, v.name);
+        snprintf(buffer, sizeof(buffer), "\",\"type\":\"%s\",\"value\":%.17g,\"%s\":%.17g,\"capacity\":%.17g,\"near_capacity\":%s}",
+                 v.type == metric_type::counter ? "counter" : "gauge", v.value,
+                 v.type == metric_type::counter ? "total" : "peak", v.total, v.capacity, v.near_capacity ? "true" : "false");
+        text += buffer;
+    }
+
+    text += "\n]\n";
+    return text;
+}
+
+bool
+save(const char* path)
+{
+    assert(path);
+    const size_t length{ strlen(path) };
+    const bool json{ length >= 5 && !strcmp(path + length - 5, ".json") };
+    const std::string text{ json ? dump_json() : dump() };
+    std::ofstream file{ path, std::ios::out | std::ios::binary };
+    if (!file) return false;
+    file.write(text.data(), text.size());
+    return file.good();
+}
+
+}
\ No newline at end of file
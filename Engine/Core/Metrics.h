@@ -0,0 +1,56 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <string>
+
+namespace primal::metrics {
+
+DEFINE_TYPED_ID(metric_id);
+
+// Counters count events (e.g. created entities). Every thread adds to its own slots, so
+// add() is lock-free and cheap enough for hot paths. The slots are summed in end_frame().
+// Gauges hold a level (e.g. live entities). They're either set by their owner or, if they
+// have a sampler, sampled in end_frame() on the calling thread.
+struct metric_type {
+    enum type : u32 {
+        counter,
+        gauge,
+    };
+};
+
+using sampler = f64(*)(void* context);
+
+struct metric_value
+{
+    const char*     name;
+    u32             type;
+    f64             value;      // counters: count in the last frame. gauges: value at the end of the last frame.
+    f64             total;      // counters: count since startup. gauges: highest value so far.
+    f64             capacity;   // 0 if the metric doesn't have a capacity.
+    bool            near_capacity; // the gauge reached warning_ratio of its capacity.
+};
+
+// Gauges that reach this part of their capacity are reported (e.g. 461 of 512 RTV descriptors).
+constexpr f64 warning_ratio{ 0.9 };
+
+// Registering a name that already exists returns the existing metric and updates its sampler and capacity.
+metric_id register_counter(const char* name);
+metric_id register_gauge(const char* name, f64 capacity = 0.0, sampler sample = nullptr, void* context = nullptr);
+// Removes the sampler of a gauge (e.g. when the sampled object is destroyed). The gauge keeps its last value.
+void remove_sampler(metric_id id);
+
+void add(metric_id id, s64 value = 1);
+void set(metric_id id, f64 value);
+void set_capacity(metric_id id, f64 capacity);
+
+// Samples the gauges and takes a snapshot of all metrics. Call once per frame.
+void end_frame();
+
+// Returns the number of metrics. If values isn't null, it's filled with the last snapshot.
+u32 get_metrics(metric_value *const values);
+// Returns the last snapshot as text, one metric per line. Metrics near their capacity are marked with "!".
+[[nodiscard]] std::string dump();
+// Returns the last snapshot as a JSON array.
+[[nodiscard]] std::string dump_json();
+// Saves dump() (or dump_json() if the path ends with ".json").
+bool save(const char* path);
+}
\ No newline at end of file
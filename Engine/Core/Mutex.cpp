@@ -0,0 +1,131 @@
+#include "Mutex.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace primal::sync {
+#if !defined(SHIPPING)
+namespace {
+
+struct lock_registry
+{
+    std::mutex                                              mutex;
+    utl::vector<std::unique_ptr<detail::lock_counters>>     entries;
+};
+
+// NOTE: locks are often globals, so the registry is created on first use.
+lock_registry&
+registry()
+{
+    static lock_registry r;
+    return r;
+}
+
+f64
+sample_contended(void* context)
+{
+    return (f64)((const detail::lock_counters*)context)->contended.load(std::memory_order_relaxed);
+}
+
+f64
+sample_wait_ms(void* context)
+{
+    return ((const detail::lock_counters*)context)->wait_ns.load(std::memory_order_relaxed) * 1e-6;
+}
+
+// NOTE: the registry must be locked.
+void
+copy_stats(lock_stats *const stats)
+{
+    const lock_registry& r{ registry() };
+    for (u32 i{ 0 }; i < r.entries.size(); ++i)
+    {
+        const detail::lock_counters& c{ *r.entries[i] };
+        stats[i] = lock_stats{ c.name, c.acquires.load(std::memory_order_relaxed), c.contended.load(std::memory_order_relaxed),
+                               c.wait_ns.load(std::memory_order_relaxed) * 1e-6, c.hold_ns.load(std::memory_order_relaxed) * 1e-6,
+                               c.max_wait_ns.load(std::memory_order_relaxed) * 1e-6 };
+    }
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+lock_counters&
+get_lock_counters(const char* name)
+{
+    assert(name && *name);
+    lock_registry& r{ registry() };
+    std::lock_guard lock{ r.mutex };
+    for (auto& entry : r.entries)
+    {
+        if (!strcmp(entry->name, name)) return *entry;
+    }
+
+    lock_counters& counters{ *r.entries.emplace_back(std::make_unique<lock_counters>()) };
+    counters.name = name;
+    metrics::register_gauge((std::string{ "locks." } + name + ".contended").c_str(), 0.0, sample_contended, &counters);
+    metrics::register_gauge((std::string{ "locks." } + name + ".wait_ms").c_str(), 0.0, sample_wait_ms, &counters);
+    return counters;
+}
+
+u64
+now()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+record_wait(lock_counters& counters, u64 wait_ns)
+{
+    counters.contended.fetch_add(1, std::memory_order_relaxed);
+    counters.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    u64 max_wait{ counters.max_wait_ns.load(std::memory_order_relaxed) };
+    while (wait_ns > max_wait && !counters.max_wait_ns.compare_exchange_weak(max_wait, wait_ns, std::memory_order_relaxed)) {}
+}
+
+} // namespace detail
+
+u32
+get_lock_stats(lock_stats *const stats)
+{
+    lock_registry& r{ registry() };
+    std::lock_guard lock{ r.mutex };
+    if (stats) copy_stats(stats);
+    return (u32)r.entries.size();
+}
+
+std::string
+dump()
+{
+    utl::vector<lock_stats> stats;
+    {
+        lock_registry& r{ registry() };
+        std::lock_guard lock{ r.mutex };
+        stats.resize(r.entries.size());
+        copy_stats(stats.data());
+    }
+    std::sort(stats.begin(), stats.end(), [](const lock_stats& a, const lock_stats& b) { return a.wait_ms > b.wait_ms; });
+
+    std::string text;
+    char buffer[256];
+    for (const lock_stats& s : stats)
+    {
+        const f64 contention{ s.acquires ? s.contended * 100.0 / s.acquires : 0.0 };
+        snprintf(buffer, sizeof(buffer), "%-32s %10llu acquires %10llu contended (%5.1f%%) wait %10.3f ms (max %.3f ms) held %10.3f ms\n",
+                 s.name, (unsigned long long)s.acquires, (unsigned long long)s.contended, contention, s.wait_ms, s.max_wait_ms, s.hold_ms);
+        text += buffer;
+    }
+
+    return text;
+}
+#else
+u32
+get_lock_stats(lock_stats *const)
+{
+    return 0;
+}
+#endif // !defined(SHIPPING)
+}
\ No newline at end of file
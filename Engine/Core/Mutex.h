@@ -0,0 +1,156 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <atomic>
+#include <thread>
+
+// Named locks that record how often they're taken, how often they were contended and how long
+// threads waited for them and held them. Locks with the same name share their statistics.
+// Waits also show up as profiler scopes with the name of the lock. In shipping builds, the locks
+// don't record anything and are as cheap as the locks they wrap.
+//
+// Usage:
+//     sync::mutex _mutex{ "descriptor heap" };
+//     std::lock_guard lock{ _mutex };
+//
+// NOTE: lock names must be string literals (or live as long as the program).
+#if !defined(SHIPPING)
+#include <string>
+#include "..\Utilities\Profiler.h"
+#endif // !defined(SHIPPING)
+
+namespace primal::sync {
+
+struct lock_stats
+{
+    const char*     name;
+    u64             acquires;
+    u64             contended;      // acquires that had to wait.
+    f64             wait_ms;        // total time spent waiting.
+    f64             hold_ms;        // total time the lock was held.
+    f64             max_wait_ms;
+};
+
+namespace detail {
+
+class spinlock_base
+{
+public:
+    void lock()
+    {
+        while (_flag.test_and_set(std::memory_order_acquire))
+        {
+            // NOTE: we only read while the lock is taken, so the cache line isn't bounced between threads.
+            while (_flag.test(std::memory_order_relaxed)) std::this_thread::yield();
+        }
+    }
+
+    bool try_lock()
+    {
+        return !_flag.test(std::memory_order_relaxed) && !_flag.test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        _flag.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag    _flag{};
+};
+
+#if !defined(SHIPPING)
+struct lock_counters
+{
+    const char*         name;
+    std::atomic<u64>    acquires{ 0 };
+    std::atomic<u64>    contended{ 0 };
+    std::atomic<u64>    wait_ns{ 0 };
+    std::atomic<u64>    hold_ns{ 0 };
+    std::atomic<u64>    max_wait_ns{ 0 };
+};
+
+lock_counters& get_lock_counters(const char* name);
+u64 now();
+void record_wait(lock_counters& counters, u64 wait_ns);
+#endif // !defined(SHIPPING)
+
+} // namespace detail
+
+#if !defined(SHIPPING)
+template<typename T>
+class basic_lock
+{
+public:
+    explicit basic_lock(const char* name) : _counters{ detail::get_lock_counters(name) } {}
+    DISABLE_COPY_AND_MOVE(basic_lock);
+
+    void lock()
+    {
+        if (!_lock.try_lock())
+        {
+            const u64 start{ detail::now() };
+            {
+                PROFILE_SCOPE(_counters.name);
+                _lock.lock();
+            }
+            _locked_at = detail::now();
+            detail::record_wait(_counters, _locked_at - start);
+        }
+        else
+        {
+            _locked_at = detail::now();
+        }
+
+        _counters.acquires.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool try_lock()
+    {
+        if (!_lock.try_lock()) return false;
+        _locked_at = detail::now();
+        _counters.acquires.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void unlock()
+    {
+        const u64 held{ detail::now() - _locked_at };
+        _lock.unlock();
+        _counters.hold_ns.fetch_add(held, std::memory_order_relaxed);
+    }
+
+private:
+    T                       _lock;
+    detail::lock_counters&  _counters;
+    // Only used by the thread that holds the lock.
+    u64                     _locked_at{ 0 };
+};
+#else
+template<typename T>
+class basic_lock
+{
+public:
+    explicit constexpr basic_lock(const char*) {}
+    DISABLE_COPY_AND_MOVE(basic_lock);
+
+    void lock() { _lock.lock(); }
+    bool try_lock() { return _lock.try_lock(); }
+    void unlock() { _lock.unlock(); }
+
+private:
+    T _lock;
+};
+#endif // !defined(SHIPPING)
+
+using mutex = basic_lock<std::mutex>;
+// For short critical sections that are rarely contended. Waiting threads yield instead of sleeping.
+using spinlock = basic_lock<detail::spinlock_base>;
+
+// Returns the number of named locks. If stats isn't null, it's filled with their statistics.
+// In shipping builds, there are no statistics.
+u32 get_lock_stats(lock_stats *const stats);
+#if !defined(SHIPPING)
+// Returns the statistics of all named locks as text, most contended first.
+[[nodiscard]] std::string dump();
+#endif // !defined(SHIPPING)
+}
\ No newline at end of file
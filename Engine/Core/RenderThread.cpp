@@ -0,0 +1,159 @@
+#include "RenderThread.h"
+#include "ThreadPlacement.h"
+#include "..\Components\Entity.h"
+#include "..\Components\Transform.h"
+#include "..\Utilities\Profiler.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace primal::render_thread {
+namespace {
+
+// The index of the latest snapshot is stored together with a flag that tells whether it's new.
+// The stop flag tells the render thread to exit.
+constexpr u32                   index_mask{ 0x3 };
+constexpr u32                   fresh_bit{ 0x4 };
+constexpr u32                   stop_bit{ 0x8 };
+
+frame_snapshot                  snapshots[3];
+// Only used by the simulation thread.
+u32                             back{ 0 };
+// Only used by the render thread.
+u32                             front{ 1 };
+// Index of the latest submitted snapshot.
+std::atomic<u32>                latest{ 2 };
+
+std::thread                     thread;
+bool                            running{ false };
+init_info                       settings{};
+render_thread::camera           current_camera{};
+
+std::atomic<u64>                submitted_frames{ 0 };
+std::atomic<u64>                rendered_frame{ 0 };
+std::atomic<u64>                rendered_count{ 0 };
+std::atomic<u64>                dropped_count{ 0 };
+std::atomic<f32>                render_ms{ 0.f };
+
+void
+render_loop()
+{
+    PROFILE_THREAD_NAME("render thread");
+    thread_placement::apply(thread_placement::thread_role::render);
+    for (;;)
+    {
+        u32 value{ latest.load(std::memory_order_acquire) };
+        while (!(value & fresh_bit))
+        {
+            if (value & stop_bit) return;
+            latest.wait(value, std::memory_order_acquire);
+            value = latest.load(std::memory_order_acquire);
+        }
+
+        // Take the latest snapshot and leave our old buffer in its place.
+        front = latest.exchange(front, std::memory_order_acq_rel) & index_mask;
+        const frame_snapshot& snapshot{ snapshots[front] };
+
+        const auto start{ std::chrono::steady_clock::now() };
+        {
+            PROFILE_SCOPE("render");
+            settings.render(snapshot, settings.context);
+        }
+        render_ms.store(std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+        rendered_count.fetch_add(1, std::memory_order_relaxed);
+        rendered_frame.store(snapshot.frame, std::memory_order_release);
+        rendered_frame.notify_all();
+    }
+}
+
+} // anonymous namespace
+
+void
+initialize(const init_info& info)
+{
+    assert(!running && info.render);
+    settings = info;
+    back = 0;
+    front = 1;
+    latest = 2;
+    submitted_frames = 0;
+    rendered_frame = 0;
+    rendered_count = 0;
+    dropped_count = 0;
+    running = true;
+    thread = std::thread{ render_loop };
+}
+
+void
+shutdown()
+{
+    if (!running) return;
+    wait_idle();
+    running = false;
+    latest.fetch_or(stop_bit, std::memory_order_release);
+    latest.notify_all();
+    thread.join();
+
+    for (frame_snapshot& snapshot : snapshots)
+    {
+        snapshot.items.clear();
+        snapshot.world.clear();
+    }
+}
+
+void
+set_camera(const camera& c)
+{
+    current_camera = c;
+}
+
+void
+submit_frame()
+{
+    assert(running);
+    PROFILE_SCOPE("render_thread::submit_frame");
+    frame_snapshot& snapshot{ snapshots[back] };
+    snapshot.frame = submitted_frames.load(std::memory_order_relaxed) + 1;
+    snapshot.camera = current_camera;
+    snapshot.items.clear();
+    game_entity::get_active_entities(snapshot.items);
+
+    const u32 count{ (u32)snapshot.items.size() };
+    const transform::render_transforms transforms{ transform::get_render_transforms() };
+    snapshot.world.resize(count);
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const id::id_type index{ id::index(snapshot.items[i]) };
+        assert(index < transforms.count);
+        snapshot.world[i] = transforms.world[index];
+    }
+
+    // Publish the snapshot and continue with the buffer that was there before. If the
+    // render thread didn't take that one yet, it's dropped.
+    const u32 previous{ latest.exchange(back | fresh_bit, std::memory_order_acq_rel) };
+    if (previous & fresh_bit) dropped_count.fetch_add(1, std::memory_order_relaxed);
+    back = previous & index_mask;
+    submitted_frames.store(snapshot.frame, std::memory_order_relaxed);
+    latest.notify_one();
+}
+
+void
+wait_idle()
+{
+    const u64 frame{ submitted_frames.load(std::memory_order_relaxed) };
+    for (u64 rendered{ rendered_frame.load(std::memory_order_acquire) }; rendered < frame;
+         rendered = rendered_frame.load(std::memory_order_acquire))
+    {
+        rendered_frame.wait(rendered, std::memory_order_acquire);
+    }
+}
+
+render_stats
+get_stats()
+{
+    return { submitted_frames.load(std::memory_order_relaxed), rendered_count.load(std::memory_order_relaxed),
+             dropped_count.load(std::memory_order_relaxed), render_ms.load(std::memory_order_relaxed) };
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "..\Components\ComponentsCommon.h"
+
+namespace primal::render_thread {
+
+struct camera
+{
+    math::m4x4  view{};
+    math::m4x4  projection{};
+};
+
+// Everything the render thread needs to draw one frame. The simulation thread fills a snapshot
+// and hands it over in submit_frame(). After that, it's never changed until the render thread
+// is done with it.
+struct frame_snapshot
+{
+    u64                                     frame{ 0 };
+    render_thread::camera                   camera{};
+    utl::vector<game_entity::entity_id>     items;  // alive and active entities.
+    utl::vector<math::m4x4>                 world;  // world matrix of each item.
+};
+
+using render_function = void(*)(const frame_snapshot& snapshot, void* context);
+
+struct init_info
+{
+    render_function     render{ nullptr };
+    void*               context{ nullptr };
+};
+
+struct render_stats
+{
+    u64 submitted_frames;
+    u64 rendered_frames;
+    u64 dropped_frames;     // frames that were replaced by a newer frame before they were rendered.
+    f32 render_ms;          // how long the last frame took to render.
+};
+
+// Snapshots are triple-buffered: the simulation thread fills one buffer while the render thread
+// draws another and the third one holds the latest finished snapshot. Neither thread waits for the
+// other. If the simulation is faster, the older snapshot is replaced, so rendering is never more
+// than one frame behind the simulation.
+// NOTE: render() runs on the render thread, so surfaces should only be resized or removed
+//       after wait_idle() (or shutdown()).
+void initialize(const init_info& info);
+void shutdown();
+
+void set_camera(const camera& c);
+// Copies the render transforms of all active entities into a snapshot and hands it to the render thread.
+// NOTE: call after transform::interpolate().
+void submit_frame();
+// Waits until the last submitted frame has been rendered.
+void wait_idle();
+[[nodiscard]] render_stats get_stats();
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "Startup.h"
+#include "..\Utilities\Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace primal::startup {
+namespace {
+
+// Entry of the startup timeline. Times are relative to the clock's epoch,
+// so that tasks of different graphs can be shown on the same timeline.
+struct log_entry
+{
+    const char* name;
+    u64         begin_ns;
+    u64         end_ns;
+    u32         depth;      // number of graphs that this task's graph is nested in.
+    bool        main_thread;
+    bool        succeeded;
+    bool        critical;
+};
+
+struct startup_log
+{
+    std::mutex              mutex;
+    utl::vector<log_entry>  entries;
+};
+
+startup_log&
+timeline()
+{
+    static startup_log l;
+    return l;
+}
+
+// Nesting depth of the graph whose task is running on this thread.
+thread_local u32 current_depth{ 0 };
+
+u64
+now()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // anonymous namespace
+
+struct init_graph::task
+{
+    const char*             name;
+    task_function           function;
+    void*                   data;
+    u32                     flags;
+    utl::vector<u32>        dependencies;
+    utl::vector<u32>        successors;
+
+    // State of the last run().
+    std::atomic<u32>        remaining{ 0 };
+    u64                     begin_ns{ 0 };
+    u64                     end_ns{ 0 };
+    bool                    main_thread{ false };
+    bool                    succeeded{ false };
+    bool                    critical{ false };
+};
+
+init_graph::init_graph() = default;
+init_graph::~init_graph() = default;
+
+task_id
+init_graph::add_task(const task_info& info)
+{
+    assert(info.name && info.function);
+    assert(info.dependencies || !info.dependency_count);
+    const u32 index{ (u32)_tasks.size() };
+    task& t{ *_tasks.emplace_back(std::make_unique<task>()) };
+    t.name = info.name;
+    t.function = info.function;
+    t.data = info.data;
+    t.flags = info.flags;
+    for (u32 i{ 0 }; i < info.dependency_count; ++i)
+    {
+        // NOTE: tasks can only depend on tasks that were added before them, so the graph can't have cycles.
+        const u32 dependency{ (u32)info.dependencies[i] };
+        assert(id::is_valid(info.dependencies[i]) && dependency < index);
+        t.dependencies.emplace_back(dependency);
+        _tasks[dependency]->successors.emplace_back(index);
+    }
+
+    return task_id{ index };
+}
+
+bool
+init_graph::run()
+{
+    const u32 count{ (u32)_tasks.size() };
+    _completed.store(0, std::memory_order_relaxed);
+    _failed.store(false, std::memory_order_relaxed);
+    _main_thread_queue.clear();
+    for (auto& t : _tasks)
+    {
+        t->remaining.store((u32)t->dependencies.size(), std::memory_order_relaxed);
+        t->begin_ns = t->end_ns = 0;
+        t->main_thread = t->succeeded = t->critical = false;
+    }
+
+    _depth = current_depth;
+    _caller = std::this_thread::get_id();
+    _start_ns = now();
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (_tasks[i]->dependencies.empty()) schedule(i);
+    }
+
+    // The calling thread runs the main thread tasks and helps the job system while it waits.
+    while (_completed.load(std::memory_order_acquire) < count)
+    {
+        u32 index{ u32_invalid_id };
+        {
+            std::lock_guard lock{ _main_thread_mutex };
+            if (!_main_thread_queue.empty())
+            {
+                index = _main_thread_queue.back();
+                _main_thread_queue.resize(_main_thread_queue.size() - 1);
+            }
+        }
+
+        if (index != u32_invalid_id) execute(index);
+        else if (!jobs::run_pending_job()) std::this_thread::yield();
+    }
+
+    // NOTE: the last jobs might still be returning after they counted themselves as completed.
+    jobs::wait(_jobs);
+    _duration_ms = (f32)((now() - _start_ns) * 1e-6);
+    mark_critical_path();
+
+    startup_log& l{ timeline() };
+    std::lock_guard lock{ l.mutex };
+    for (const auto& t : _tasks)
+    {
+        l.entries.emplace_back(log_entry{ t->name, t->begin_ns, t->end_ns, _depth, t->main_thread, t->succeeded, t->critical });
+    }
+
+    return !_failed.load(std::memory_order_relaxed);
+}
+
+u32
+init_graph::get_timings(task_timing *const timings) const
+{
+    const u32 count{ (u32)_tasks.size() };
+    if (!timings) return count;
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const task& t{ *_tasks[i] };
+        timings[i] = task_timing{ t.name, (f32)((t.begin_ns - _start_ns) * 1e-6), (f32)((t.end_ns - t.begin_ns) * 1e-6),
+                                  t.main_thread, t.succeeded, t.critical };
+    }
+
+    return count;
+}
+
+void
+init_graph::run_task(void* data, u32 index, u32)
+{
+    ((init_graph*)data)->execute(index);
+}
+
+void
+init_graph::execute(u32 index)
+{
+    task& t{ *_tasks[index] };
+    t.main_thread = std::this_thread::get_id() == _caller;
+    t.begin_ns = now();
+    // NOTE: after a failure we don't start any new tasks, but we still complete the
+    //       skipped ones, so that run() knows when all tasks are done.
+    if (!_failed.load(std::memory_order_acquire))
+    {
+        PROFILE_SCOPE(t.name);
+        const u32 depth{ current_depth };
+        current_depth = _depth + 1;
+        t.succeeded = t.function(t.data);
+        current_depth = depth;
+        if (!t.succeeded) _failed.store(true, std::memory_order_release);
+    }
+    t.end_ns = now();
+
+    for (const u32 successor : t.successors)
+    {
+        if (_tasks[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) schedule(successor);
+    }
+
+    _completed.fetch_add(1, std::memory_order_release);
+}
+
+void
+init_graph::schedule(u32 index)
+{
+    if (_tasks[index]->flags & task_flags::main_thread)
+    {
+        std::lock_guard lock{ _main_thread_mutex };
+        _main_thread_queue.emplace_back(index);
+        return;
+    }
+
+    const jobs::job job{ &run_task, this, index, index + 1 };
+    jobs::run(&job, 1, &_jobs);
+}
+
+// The critical path ends with the task that finished last. From there, we follow
+// the dependencies that finished last, because those were the ones the tasks waited for.
+void
+init_graph::mark_critical_path()
+{
+    u32 index{ u32_invalid_id };
+    u64 end_ns{ 0 };
+    for (u32 i{ 0 }; i < _tasks.size(); ++i)
+    {
+        if (_tasks[i]->end_ns >= end_ns)
+        {
+            end_ns = _tasks[i]->end_ns;
+            index = i;
+        }
+    }
+
+    while (index != u32_invalid_id)
+    {
+        task& t{ *_tasks[index] };
+        t.critical = true;
+        index = u32_invalid_id;
+        end_ns = 0;
+        for (const u32 dependency : t.dependencies)
+        {
+            if (_tasks[dependency]->end_ns >= end_ns)
+            {
+                end_ns = _tasks[dependency]->end_ns;
+                index = dependency;
+            }
+        }
+    }
+}
+
+std::string
+report()
+{
+    utl::vector<log_entry> entries;
+    {
+        startup_log& l{ timeline() };
+        std::lock_guard lock{ l.mutex };
+        entries = l.entries;
+    }
+
+    if (entries.empty()) return {};
+    std::stable_sort(entries.begin(), entries.end(), [](const log_entry& a, const log_entry& b) { return a.begin_ns < b.begin_ns; });
+
+    u64 start_ns{ entries[0].begin_ns };
+    u64 end_ns{ 0 };
+    for (const log_entry& e : entries) end_ns = std::max(end_ns, e.end_ns);
+    const f64 total_ms{ (end_ns - start_ns) * 1e-6 };
+
+    constexpr u32 bar_width{ 50 };
+    std::string text;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "Startup: %.3f ms (* = critical path, ! = failed or skipped)\n", total_ms);
+    text += buffer;
+    for (const log_entry& e : entries)
+    {
+        const f64 begin_ms{ (e.begin_ns - start_ns) * 1e-6 };
+        const f64 duration_ms{ (e.end_ns - e.begin_ns) * 1e-6 };
+        char bar[bar_width + 1];
+        memset(bar, ' ', bar_width);
+        bar[bar_width] = 0;
+        if (total_ms > 0.0)
+        {
+            const u32 first{ std::min((u32)(begin_ms / total_ms * bar_width), bar_width - 1) };
+            const u32 last{ std::max(first, std::min((u32)((begin_ms + duration_ms) / total_ms * bar_width), bar_width - 1)) };
+            memset(&bar[first], '#', last - first + 1);
+        }
+
+        snprintf(buffer, sizeof(buffer), "%c%c %9.3f ms %9.3f ms %-6s |%s| %*s%s\n",
+                 e.critical ? '*' : ' ', e.succeeded ? ' ' : '!', begin_ms, duration_ms, e.main_thread ? "main" : "worker",
+                 bar, (int)(e.depth * 2), "", e.name);
+        text += buffer;
+    }
+
+    return text;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "JobSystem.h"
+#include <string>
+#include <thread>
+
+namespace primal::startup {
+
+DEFINE_TYPED_ID(task_id);
+
+// Returns false if the initialization failed.
+using task_function = bool(*)(void* data);
+
+struct task_flags {
+    enum flags : u32 {
+        none = 0x00,
+        // The task runs on the thread that calls run() (e.g. tasks that create windows).
+        main_thread = 0x01,
+    };
+};
+
+// NOTE: the name must be a string literal (or live as long as the program), because it's
+//       also used for the profiler scope of the task and for the startup report.
+struct task_info
+{
+    const char*         name{ nullptr };
+    task_function       function{ nullptr };
+    void*               data{ nullptr };
+    const task_id*      dependencies{ nullptr };
+    u32                 dependency_count{ 0 };
+    u32                 flags{ task_flags::none };
+};
+
+struct task_timing
+{
+    const char*         name;
+    f32                 begin_ms;       // relative to the start of run().
+    f32                 duration_ms;
+    bool                main_thread;    // the task ran on the thread that called run().
+    bool                succeeded;      // false if the task failed or was skipped.
+    bool                critical;       // the task is on the critical path of the graph.
+};
+
+// Initialization tasks and their dependencies. Tasks that don't depend on each other run
+// concurrently on the job system. A task can only depend on tasks that were added before it.
+// If a task fails, the tasks that haven't started yet are skipped and run() returns false.
+// NOTE: a graph can be run from inside a task of another graph (e.g. graphics initialization).
+//       Main thread tasks then run on the thread that runs the outer task.
+class init_graph
+{
+public:
+    init_graph();
+    ~init_graph();
+    DISABLE_COPY_AND_MOVE(init_graph);
+
+    task_id add_task(const task_info& info);
+    bool run();
+
+    // Returns the number of tasks. If timings isn't null, it's filled with the timings of the last run().
+    u32 get_timings(task_timing *const timings) const;
+    f32 duration_ms() const { return _duration_ms; }
+
+private:
+    struct task;
+    static void run_task(void* data, u32 index, u32);
+    void execute(u32 index);
+    void schedule(u32 index);
+    void mark_critical_path();
+
+    utl::vector<std::unique_ptr<task>>  _tasks;
+    utl::vector<u32>                    _main_thread_queue;
+    std::mutex                          _main_thread_mutex;
+    std::atomic<u32>                    _completed{ 0 };
+    std::atomic<bool>                   _failed{ false };
+    std::thread::id                     _caller{};
+    u64                                 _start_ns{ 0 };
+    u32                                 _depth{ 0 };
+    f32                                 _duration_ms{ 0.f };
+    jobs::counter                       _jobs;
+};
+
+// Returns the timeline of all startup tasks that ran so far (in all graphs) as text, in the
+// order in which they started, with a bar that shows when each task ran and which tasks
+// were on the critical path.
+[[nodiscard]] std::string report();
+}
\ No newline at end of file
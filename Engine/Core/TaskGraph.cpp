@@ -0,0 +1,652 @@
+#include "TaskGraph.h"
+#include "JobSystem.h"
+#include "Metrics.h"
+#include "..\Utilities\Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN64
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // !WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif // _WIN64
+
+namespace primal::task_graph {
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct resource
+{
+    std::string                 name;
+};
+
+struct stage
+{
+    std::string                 name;
+    stage_function              function;
+    void*                       data;
+    u32                         flags;
+    utl::vector<u32>            dependencies;
+    utl::vector<u32>            reads;
+    utl::vector<u32>            writes;
+
+    // Filled in by compile().
+    utl::vector<u32>            predecessors;
+    utl::vector<u32>            successors;
+    // Only for overlapping stages: the stages of the next frame that have to wait for this stage.
+    utl::vector<u32>            next_frame_successors;
+
+    // NOTE: the timings of overlapping stages are written while the next frame is running.
+    std::atomic<f32>            begin_ms{ 0.f };
+    std::atomic<f32>            duration_ms{ 0.f };
+    std::atomic<f32>            average_ms{ 0.f };
+
+    // Budget overruns. The pending flag is cleared when the overrun is reported.
+    std::atomic<f32>            budget_ms{ 0.f };
+    std::atomic<f32>            overrun_ms{ 0.f };
+    std::atomic<u32>            overruns{ 0 };
+    std::atomic<bool>           overrun_pending{ false };
+    metrics::metric_id          overrun_metric{ id::invalid_id };
+    const char*                 scope_name{ nullptr };
+    // Only used by the thread that calls execute().
+    clock::time_point           last_warning{};
+    u32                         unreported_overruns{ 0 };
+};
+
+// State of one frame that is being executed. There are two contexts, so that overlapping
+// stages of one frame can still run while the next frame starts.
+struct frame_context
+{
+    // Number of stages each stage is still waiting for.
+    std::unique_ptr<std::atomic<u32>[]> remaining;
+    // Overlapping stages that have finished. Guarded by cross_frame_mutex.
+    utl::vector<u8>                     done;
+    bool                                next_frame_started{ false };
+    jobs::counter                       stages_left;
+    jobs::counter                       overlapping_left;
+    clock::time_point                   start;
+};
+
+struct main_thread_stage
+{
+    frame_context*  context;
+    u32             stage;
+};
+
+utl::vector<std::unique_ptr<resource>>  resources;
+utl::vector<std::unique_ptr<stage>>     stages;
+frame_context                           contexts[2];
+u64                                     frame_index{ 0 };
+u32                                     overlapping_count{ 0 };
+f32                                     last_frame_ms{ 0.f };
+bool                                    compiled{ false };
+
+std::mutex                              cross_frame_mutex;
+utl::vector<main_thread_stage>          main_thread_queue;
+std::mutex                              main_thread_mutex;
+
+constexpr f32                           average_weight{ 0.1f };
+
+overrun_callback                        overrun_handler{ nullptr };
+void*                                   overrun_context{ nullptr };
+clock::duration                         warning_interval{ std::chrono::seconds{ 1 } };
+
+// NOTE: the profiler keeps the names of its scopes, so they aren't removed by reset().
+utl::vector<std::unique_ptr<std::string>> scope_names;
+
+const char*
+get_scope_name(const std::string& name)
+{
+    for (const auto& scope_name : scope_names)
+    {
+        if (*scope_name == name) return scope_name->c_str();
+    }
+
+    return scope_names.emplace_back(std::make_unique<std::string>(name))->c_str();
+}
+
+constexpr bool
+is_overlapping(const stage& s)
+{
+    return s.flags & stage_flags::overlap_next_frame;
+}
+
+bool
+is_idle()
+{
+    return contexts[0].overlapping_left.is_done() && contexts[1].overlapping_left.is_done();
+}
+
+bool
+contains(const utl::vector<u32>& items, u32 value)
+{
+    for (const u32 item : items) if (item == value) return true;
+    return false;
+}
+
+bool
+intersects(const utl::vector<u32>& a, const utl::vector<u32>& b)
+{
+    for (const u32 item : a) if (contains(b, item)) return true;
+    return false;
+}
+
+// Two stages conflict if one of them writes a resource that the other one reads or writes.
+bool
+conflicts(const stage& a, const stage& b)
+{
+    return intersects(a.writes, b.writes) || intersects(a.writes, b.reads) || intersects(a.reads, b.writes);
+}
+
+void run_stage_job(void* data, u32 begin, u32);
+
+void
+launch(frame_context& context, u32 index)
+{
+    if (stages[index]->flags & stage_flags::main_thread)
+    {
+        std::lock_guard lock{ main_thread_mutex };
+        main_thread_queue.emplace_back(main_thread_stage{ &context, index });
+        return;
+    }
+
+    const jobs::job job{ &run_stage_job, &context, index, index + 1 };
+    jobs::run(&job, 1);
+}
+
+void
+run_stage(frame_context& context, u32 index)
+{
+    stage& s{ *stages[index] };
+    const clock::time_point begin{ clock::now() };
+    {
+        PROFILE_SCOPE(s.scope_name);
+        s.function(s.data);
+    }
+    const clock::time_point end{ clock::now() };
+
+    const f32 duration{ std::chrono::duration<f32, std::milli>(end - begin).count() };
+    const f32 average{ s.average_ms.load(std::memory_order_relaxed) };
+    s.begin_ms.store(std::chrono::duration<f32, std::milli>(begin - context.start).count(), std::memory_order_relaxed);
+    s.duration_ms.store(duration, std::memory_order_relaxed);
+    s.average_ms.store(average > 0.f ? average + (duration - average) * average_weight : duration, std::memory_order_relaxed);
+
+    const f32 budget{ s.budget_ms.load(std::memory_order_relaxed) };
+    if (budget > 0.f && duration > budget)
+    {
+        s.overrun_ms.store(duration, std::memory_order_relaxed);
+        s.overruns.fetch_add(1, std::memory_order_relaxed);
+        s.overrun_pending.store(true, std::memory_order_release);
+        metrics::add(s.overrun_metric);
+    }
+
+    for (const u32 successor : s.successors)
+    {
+        if (context.remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) launch(context, successor);
+    }
+
+    if (!is_overlapping(s))
+    {
+        context.stages_left.value.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    // NOTE: if the next frame has already started, some of its stages might be waiting for us.
+    //       We launch them after releasing the lock, because they might run right away.
+    frame_context& next{ &context == &contexts[0] ? contexts[1] : contexts[0] };
+    utl::vector<u32> ready;
+    {
+        std::lock_guard lock{ cross_frame_mutex };
+        context.done[index] = 1;
+        if (context.next_frame_started)
+        {
+            for (const u32 successor : s.next_frame_successors)
+            {
+                if (next.remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) ready.emplace_back(successor);
+            }
+        }
+    }
+
+    for (const u32 successor : ready) launch(next, successor);
+    context.overlapping_left.value.fetch_sub(1, std::memory_order_release);
+}
+
+void
+run_stage_job(void* data, u32 begin, u32)
+{
+    run_stage(*static_cast<frame_context*>(data), begin);
+}
+
+bool
+run_main_thread_stage()
+{
+    main_thread_stage s;
+    {
+        std::lock_guard lock{ main_thread_mutex };
+        if (main_thread_queue.empty()) return false;
+        s = main_thread_queue.back();
+        main_thread_queue.erase(main_thread_queue.size() - 1);
+    }
+
+    run_stage(*s.context, s.stage);
+    return true;
+}
+
+// Finds the longest path through the graph, using the average durations of the stages.
+// Returns the length of the path and marks the stages that are on it.
+f32
+find_critical_path(utl::vector<u8>& critical)
+{
+    const u32 count{ (u32)stages.size() };
+    critical.clear();
+    critical.resize(count, 0);
+    if (!count) return 0.f;
+
+    // NOTE: predecessors are always added before their successors, so we can go in order.
+    utl::vector<f32> length(count);
+    utl::vector<u32> previous(count, u32_invalid_id);
+    u32 last{ 0 };
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        f32 start{ 0.f };
+        for (const u32 p : stages[i]->predecessors)
+        {
+            if (length[p] <= start) continue;
+            start = length[p];
+            previous[i] = p;
+        }
+
+        length[i] = start + stages[i]->average_ms.load(std::memory_order_relaxed);
+        if (length[i] > length[last]) last = i;
+    }
+
+    for (u32 i{ last }; i != u32_invalid_id; i = previous[i]) critical[i] = 1;
+    return length[last];
+}
+
+void
+print_warning(const char* text)
+{
+#ifdef _WIN64
+    OutputDebugStringA(text);
+#else
+    fputs(text, stderr);
+#endif // _WIN64
+}
+
+#if !defined(SHIPPING)
+// Appends the slowest direct child scopes of the stage in the last profiled frame.
+void
+append_top_contributors(std::string& text, const char* name)
+{
+    constexpr u32 max_contributors{ 3 };
+    utl::vector<profiler::scope_stats> scopes(profiler::get_frame_stats(nullptr));
+    scopes.resize(profiler::get_frame_stats(scopes.data()));
+
+    utl::vector<profiler::scope_stats> children;
+    for (u32 i{ 0 }; i < scopes.size(); ++i)
+    {
+        if (strcmp(scopes[i].name, name)) continue;
+        for (const profiler::scope_stats& child : scopes)
+        {
+            if (child.parent == i && child.calls) children.emplace_back(child);
+        }
+    }
+
+    if (children.empty()) return;
+    std::sort(children.begin(), children.end(), [](const profiler::scope_stats& a, const profiler::scope_stats& b)
+              {
+                  return a.total_ms > b.total_ms;
+              });
+
+    char buffer[256];
+    text += "    top contributors:";
+    for (u32 i{ 0 }; i < children.size() && i < max_contributors; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), "%s %s %.3f ms (%u calls)", i ? "," : "", children[i].name, children[i].total_ms, children[i].calls);
+        text += buffer;
+    }
+    text += "\n";
+}
+#endif // !defined(SHIPPING)
+
+void
+report_overrun(u32 index)
+{
+    stage& s{ *stages[index] };
+    const overrun_info info{ stage_id{ index }, s.name.c_str(), s.overrun_ms.load(std::memory_order_relaxed),
+                             s.budget_ms.load(std::memory_order_relaxed), s.overruns.load(std::memory_order_relaxed) };
+    if (overrun_handler) overrun_handler(info, overrun_context);
+
+    ++s.unreported_overruns;
+    const clock::time_point now{ clock::now() };
+    if (now - s.last_warning < warning_interval) return;
+    s.last_warning = now;
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "WARNING: stage \"%s\" took %.3f ms (budget %.3f ms). Overruns: %u since the last warning, %u in total.\n",
+             info.name, info.duration_ms, info.budget_ms, s.unreported_overruns, info.overruns);
+    s.unreported_overruns = 0;
+    std::string text{ buffer };
+#if !defined(SHIPPING)
+    append_top_contributors(text, info.name);
+#endif // !defined(SHIPPING)
+    print_warning(text.c_str());
+}
+
+void
+append_resource_names(std::string& text, const char* label, const utl::vector<u32>& items)
+{
+    if (items.empty()) return;
+    text += "\\n";
+    text += label;
+    for (u32 i{ 0 }; i < items.size(); ++i)
+    {
+        text += i ? ", " : " ";
+        text += resources[items[i]]->name;
+    }
+}
+
+} // anonymous namespace
+
+resource_id
+add_resource(const char* name)
+{
+    assert(name && is_idle());
+    const resource_id id{ (id::id_type)resources.size() };
+    resources.emplace_back(std::make_unique<resource>())->name = name;
+    compiled = false;
+    return id;
+}
+
+stage_id
+add_stage(const stage_info& info)
+{
+    assert(info.name && info.function && is_idle());
+    assert(!(info.flags & stage_flags::main_thread) || !(info.flags & stage_flags::overlap_next_frame));
+    const stage_id id{ (id::id_type)stages.size() };
+    stage& s{ *stages.emplace_back(std::make_unique<stage>()) };
+    s.name = info.name;
+    s.function = info.function;
+    s.data = info.data;
+    s.flags = info.flags;
+    s.budget_ms = info.budget_ms;
+    s.overrun_metric = metrics::register_counter(("budgets." + s.name + ".overruns").c_str());
+    s.scope_name = get_scope_name(s.name);
+
+    for (u32 i{ 0 }; i < info.dependency_count; ++i)
+    {
+        assert(info.dependencies[i] < id);
+        s.dependencies.emplace_back(info.dependencies[i]);
+    }
+
+    for (u32 i{ 0 }; i < info.read_count; ++i)
+    {
+        assert(info.reads[i] < resources.size());
+        s.reads.emplace_back(info.reads[i]);
+    }
+
+    for (u32 i{ 0 }; i < info.write_count; ++i)
+    {
+        assert(info.writes[i] < resources.size());
+        s.writes.emplace_back(info.writes[i]);
+    }
+
+    compiled = false;
+    return id;
+}
+
+void
+compile()
+{
+    assert(is_idle());
+    const u32 count{ (u32)stages.size() };
+    const u32 words{ (count + 63) >> 6 };
+
+    // reachable[i] has a bit for every stage that stage i (indirectly) depends on.
+    utl::vector<u64> reachable((u64)count * words, 0);
+    utl::vector<u32> candidates;
+    overlapping_count = 0;
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        stage& s{ *stages[i] };
+        s.predecessors.clear();
+        s.successors.clear();
+        s.next_frame_successors.clear();
+
+        candidates.clear();
+        for (u32 j{ 0 }; j < i; ++j)
+        {
+            if (contains(s.dependencies, j) || conflicts(*stages[j], s)) candidates.emplace_back(j);
+        }
+
+        // NOTE: we skip dependencies that are already implied by other dependencies.
+        //       Candidates are checked from the last one, because a stage can only
+        //       depend on stages that were added before it.
+        u64 *const reach{ &reachable[(u64)i * words] };
+        for (u32 c{ (u32)candidates.size() }; c > 0; --c)
+        {
+            const u32 p{ candidates[c - 1] };
+            if (reach[p >> 6] & (1ull << (p & 63))) continue;
+            assert(is_overlapping(s) || !is_overlapping(*stages[p]));
+            s.predecessors.emplace_back(p);
+            stages[p]->successors.emplace_back(i);
+
+            const u64 *const p_reach{ &reachable[(u64)p * words] };
+            for (u32 w{ 0 }; w < words; ++w) reach[w] |= p_reach[w];
+            reach[p >> 6] |= 1ull << (p & 63);
+        }
+
+        if (is_overlapping(s)) ++overlapping_count;
+    }
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        stage& s{ *stages[i] };
+        if (!is_overlapping(s)) continue;
+        for (u32 j{ 0 }; j < count; ++j)
+        {
+            if (i == j || conflicts(s, *stages[j])) s.next_frame_successors.emplace_back(j);
+        }
+    }
+
+    for (frame_context& context : contexts)
+    {
+        context.remaining = count ? std::make_unique<std::atomic<u32>[]>(count) : nullptr;
+        context.done.clear();
+        context.done.resize(count, 0);
+        context.next_frame_started = false;
+    }
+
+    frame_index = 0;
+    compiled = true;
+}
+
+void
+reset()
+{
+    wait_idle();
+    resources.clear();
+    stages.clear();
+    for (frame_context& context : contexts)
+    {
+        context.remaining.reset();
+        context.done.clear();
+    }
+
+    frame_index = 0;
+    overlapping_count = 0;
+    compiled = false;
+}
+
+void
+execute()
+{
+    assert(compiled);
+    const u32 count{ (u32)stages.size() };
+    frame_context& context{ contexts[frame_index & 1] };
+
+    // NOTE: overruns of overlapping stages might be reported a frame later.
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (stages[i]->overrun_pending.exchange(false, std::memory_order_acq_rel)) report_overrun(i);
+    }
+
+    // NOTE: this context was last used two frames ago. Its overlapping stages
+    //       have to finish before we can reuse it.
+    jobs::wait(context.overlapping_left);
+
+    // Every stage waits for one more "stage" until all stages are set up. This way,
+    // stages that are launched by the previous frame in the meantime aren't launched twice.
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        context.remaining[i].store((u32)stages[i]->predecessors.size() + 1, std::memory_order_relaxed);
+        context.done[i] = 0;
+    }
+
+    context.next_frame_started = false;
+    context.stages_left.value.store(count - overlapping_count, std::memory_order_relaxed);
+    context.overlapping_left.value.store(overlapping_count, std::memory_order_relaxed);
+    context.start = clock::now();
+
+    if (frame_index > 0 && overlapping_count)
+    {
+        frame_context& previous{ contexts[(frame_index - 1) & 1] };
+        std::lock_guard lock{ cross_frame_mutex };
+        previous.next_frame_started = true;
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            if (previous.done[i] || !is_overlapping(*stages[i])) continue;
+            for (const u32 successor : stages[i]->next_frame_successors)
+            {
+                context.remaining[successor].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        if (context.remaining[i].fetch_sub(1, std::memory_order_acq_rel) == 1) launch(context, i);
+    }
+
+    while (!context.stages_left.is_done())
+    {
+        if (run_main_thread_stage() || jobs::run_pending_job()) continue;
+        std::this_thread::yield();
+    }
+
+    last_frame_ms = std::chrono::duration<f32, std::milli>(clock::now() - context.start).count();
+    ++frame_index;
+}
+
+void
+wait_idle()
+{
+    for (frame_context& context : contexts) jobs::wait(context.overlapping_left);
+}
+
+void
+set_budget(stage_id id, f32 budget_ms)
+{
+    assert(id < stages.size() && budget_ms >= 0.f);
+    stages[id]->budget_ms.store(budget_ms, std::memory_order_relaxed);
+}
+
+void
+set_overrun_callback(overrun_callback callback, void* context)
+{
+    overrun_handler = callback;
+    overrun_context = context;
+}
+
+void
+set_warning_interval(f32 seconds)
+{
+    assert(seconds >= 0.f);
+    warning_interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<f32>{ seconds });
+}
+
+u32
+get_timings(stage_timing *const timings)
+{
+    const u32 count{ (u32)stages.size() };
+    if (!timings) return count;
+
+    utl::vector<u8> critical;
+    find_critical_path(critical);
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const stage& s{ *stages[i] };
+        timings[i] = stage_timing{ s.name.c_str(), s.begin_ms.load(std::memory_order_relaxed),
+                                   s.duration_ms.load(std::memory_order_relaxed),
+                                   s.average_ms.load(std::memory_order_relaxed), s.budget_ms.load(std::memory_order_relaxed),
+                                   s.overruns.load(std::memory_order_relaxed), critical[i] != 0 };
+    }
+
+    return count;
+}
+
+f32
+frame_time_ms()
+{
+    return last_frame_ms;
+}
+
+std::string
+dump()
+{
+    utl::vector<u8> critical;
+    const f32 critical_ms{ find_critical_path(critical) };
+    const u32 count{ (u32)stages.size() };
+
+    std::string text{ "digraph frame {\n    rankdir=LR;\n    node [shape=box];\n" };
+    char buffer[256];
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const stage& s{ *stages[i] };
+        std::string label{ s.name };
+        snprintf(buffer, sizeof(buffer), "\\n%.3f ms (avg %.3f ms) at %.3f ms", s.duration_ms.load(), s.average_ms.load(), s.begin_ms.load());
+        label += buffer;
+        if (s.budget_ms > 0.f)
+        {
+            snprintf(buffer, sizeof(buffer), "\\nbudget %.3f ms (%u overruns)", s.budget_ms.load(), s.overruns.load());
+            label += buffer;
+        }
+        append_resource_names(label, "reads:", s.reads);
+        append_resource_names(label, "writes:", s.writes);
+        if (s.flags & stage_flags::main_thread) label += "\\n[main thread]";
+        if (is_overlapping(s)) label += "\\n[overlaps next frame]";
+
+        snprintf(buffer, sizeof(buffer), "    s%u [label=\"", i);
+        text += buffer;
+        text += label;
+        text += critical[i] ? "\" color=red penwidth=2];\n" : "\"];\n";
+    }
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        for (const u32 successor : stages[i]->successors)
+        {
+            snprintf(buffer, sizeof(buffer), "    s%u -> s%u%s;\n", i, successor,
+                     critical[i] && critical[successor] ? " [color=red penwidth=2]" : "");
+            text += buffer;
+        }
+
+        for (const u32 successor : stages[i]->next_frame_successors)
+        {
+            snprintf(buffer, sizeof(buffer), "    s%u -> s%u [style=dashed label=\"next frame\"];\n", i, successor);
+            text += buffer;
+        }
+    }
+
+    snprintf(buffer, sizeof(buffer), "    label=\"critical path: %.3f ms, last frame: %.3f ms\";\n}\n", critical_ms, last_frame_ms);
+    text += buffer;
+    return text;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <string>
+
+namespace primal::task_graph {
+
+DEFINE_TYPED_ID(stage_id);
+DEFINE_TYPED_ID(resource_id);
+
+using stage_function = void(*)(void* data);
+
+struct stage_flags {
+    enum flags : u32 {
+        none = 0x00,
+        // The stage always runs on the thread that calls execute() (e.g. stages that use the window).
+        main_thread = 0x01,
+        // The stage may still be running when the next frame starts (e.g. render submission).
+        // Stages of the next frame that use the same resources wait for it. Only other
+        // overlapping stages can depend on an overlapping stage.
+        overlap_next_frame = 0x02,
+    };
+};
+
+// A stage runs once per frame after all stages it depends on have finished. Besides the
+// explicit dependencies, a stage also depends on every stage that was added before it and
+// writes a resource that it reads or writes, or reads a resource that it writes.
+// Stages that don't depend on each other run concurrently on the job system.
+struct stage_info
+{
+    const char*             name{ nullptr };
+    stage_function          function{ nullptr };
+    void*                   data{ nullptr };
+    const stage_id*         dependencies{ nullptr };
+    u32                     dependency_count{ 0 };
+    const resource_id*      reads{ nullptr };
+    u32                     read_count{ 0 };
+    const resource_id*      writes{ nullptr };
+    u32                     write_count{ 0 };
+    u32                     flags{ stage_flags::none };
+    f32                     budget_ms{ 0.f };       // 0 means the stage doesn't have a time budget.
+};
+
+struct stage_timing
+{
+    const char*     name;
+    f32             begin_ms;       // when the stage started in its last frame, relative to the start of that frame.
+    f32             duration_ms;    // duration in the last frame.
+    f32             average_ms;     // moving average of the duration.
+    f32             budget_ms;
+    u32             overruns;       // number of times the stage took longer than its budget.
+    bool            critical;       // the stage is on the critical path (based on the average durations).
+};
+
+struct overrun_info
+{
+    stage_id        stage;
+    const char*     name;
+    f32             duration_ms;
+    f32             budget_ms;
+    u32             overruns;       // total number of overruns of this stage.
+};
+
+// Called for every overrun, e.g. to shed load by lowering script update rates.
+using overrun_callback = void(*)(const overrun_info& info, void* context);
+
+// NOTE: the graph can only be changed while it's idle, i.e. before the first execute()
+//       or after wait_idle(). compile() must be called after the graph has changed.
+resource_id add_resource(const char* name);
+stage_id add_stage(const stage_info& info);
+void compile();
+void reset();
+
+// Runs all stages of one frame. Returns when all stages have finished, except for overlapping
+// stages, which may still be running. The calling thread runs the main thread stages and
+// helps the job system while it waits.
+void execute();
+// Waits for overlapping stages of previous frames.
+void wait_idle();
+
+// Budgets can be changed at any time. Overruns are counted (also in the metrics, see Metrics.h)
+// and reported at the start of the next execute(), on the thread that calls it: the callback
+// is called for each of them and a warning is printed with the slowest profiler scopes of the
+// stage. Warnings are printed at most once per warning interval for each stage.
+void set_budget(stage_id id, f32 budget_ms);
+void set_overrun_callback(overrun_callback callback, void* context);
+void set_warning_interval(f32 seconds);
+
+// Returns the number of stages. If timings isn't null, it's filled with the timings of the stages.
+u32 get_timings(stage_timing *const timings);
+[[nodiscard]] f32 frame_time_ms();
+// Returns the compiled graph in Graphviz DOT format, including the stage timings.
+// The critical path is highlighted.
+[[nodiscard]] std::string dump();
+}
\ No newline at end of file
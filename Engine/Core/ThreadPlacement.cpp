@@ -0,0 +1,283 @@
+#include "ThreadPlacement.h"
+#include "..\Platform\CpuTopology.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace primal::thread_placement {
+namespace {
+
+struct core_info
+{
+    u32     core;
+    u32     cache_group;
+    u32     efficiency_class;
+    u32     first;          // index of the first processor of this core in core_processors.
+    u32     count;
+};
+
+// The processors of each role are stored in one array. Workers have their own sets,
+// which are stored back to back (see worker_offsets).
+struct placement
+{
+    config              settings{};
+    utl::vector<u32>    processors[thread_role::worker];
+    utl::vector<u32>    worker_processors;
+    utl::vector<u32>    worker_offsets;     // worker i uses worker_processors[worker_offsets[i]..worker_offsets[i + 1]).
+    u32                 worker_count{ 0 };
+    bool                initialized{ false };
+};
+
+placement   layout{};
+
+void
+add_core(utl::vector<u32>& list, const core_info& c, const utl::vector<u32>& core_processors)
+{
+    for (u32 i{ 0 }; i < c.count; ++i) list.emplace_back(core_processors[c.first + i]);
+}
+
+void
+add_worker(const u32 *const processors, u32 count)
+{
+    for (u32 i{ 0 }; i < count; ++i) layout.worker_processors.emplace_back(processors[i]);
+    layout.worker_offsets.emplace_back((u32)layout.worker_processors.size());
+}
+
+// Writes a list of processors as ranges (e.g. "0-3,8,10-11").
+std::string
+to_ranges(const u32 *const processors, u32 count)
+{
+    if (!count) return "any";
+    utl::vector<u32> sorted{};
+    sorted.resize(count);
+    memcpy(sorted.data(), processors, count * sizeof(u32));
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string text;
+    char buffer[32];
+    for (u32 i{ 0 }; i < count;)
+    {
+        u32 last{ i };
+        while (last + 1 < count && sorted[last + 1] == sorted[last] + 1) ++last;
+        if (last == i) snprintf(buffer, sizeof(buffer), "%s%u", text.empty() ? "" : ",", sorted[i]);
+        else snprintf(buffer, sizeof(buffer), "%s%u-%u", text.empty() ? "" : ",", sorted[i], sorted[last]);
+        text += buffer;
+        i = last + 1;
+    }
+
+    return text;
+}
+
+} // anonymous namespace
+
+void
+initialize(const config& settings)
+{
+    layout = {};
+    layout.settings = settings;
+    layout.worker_offsets.emplace_back(0);
+
+    const platform::cpu_topology& topology{ platform::get_cpu_topology() };
+    const u32 processor_count{ (u32)topology.processors.size() };
+
+    // Group the processors by core.
+    utl::vector<core_info> cores{};
+    cores.resize(topology.core_count, core_info{});
+    for (u32 i{ 0 }; i < topology.core_count; ++i) cores[i].core = i;
+    for (const platform::logical_processor& p : topology.processors)
+    {
+        core_info& c{ cores[p.core] };
+        c.cache_group = p.cache_group;
+        c.efficiency_class = p.efficiency_class;
+        ++c.count;
+    }
+
+    u32 offset{ 0 };
+    for (core_info& c : cores)
+    {
+        c.first = offset;
+        offset += c.count;
+        c.count = 0;
+    }
+
+    utl::vector<u32> core_processors{};
+    core_processors.resize(processor_count);
+    for (const platform::logical_processor& p : topology.processors)
+    {
+        core_info& c{ cores[p.core] };
+        core_processors[c.first + c.count++] = p.index;
+    }
+
+    // Fast cores first. Cores of the same cache group stay together.
+    std::sort(cores.begin(), cores.end(), [](const core_info& a, const core_info& b)
+              {
+                  if (a.efficiency_class != b.efficiency_class) return a.efficiency_class > b.efficiency_class;
+                  if (a.cache_group != b.cache_group) return a.cache_group < b.cache_group;
+                  return a.core < b.core;
+              });
+
+    u32 first_worker_core{ 0 };
+    if (!cores.empty())
+    {
+        add_core(layout.processors[thread_role::main], cores[0], core_processors);
+        first_worker_core = 1;
+
+        // The render thread prefers a fast core that shares the cache with the main thread.
+        if (settings.dedicated_render_core && cores.size() > 1)
+        {
+            u32 render_core{ 1 };
+            for (u32 i{ 1 }; i < cores.size() && cores[i].efficiency_class == cores[0].efficiency_class; ++i)
+            {
+                if (cores[i].cache_group == cores[0].cache_group)
+                {
+                    render_core = i;
+                    break;
+                }
+            }
+
+            // NOTE: keep the remaining cores in order by moving the render core to the front.
+            const core_info render{ cores[render_core] };
+            for (u32 i{ render_core }; i > 1; --i) cores[i] = cores[i - 1];
+            cores[1] = render;
+            first_worker_core = 2;
+        }
+
+        add_core(layout.processors[thread_role::render], cores[first_worker_core - 1], core_processors);
+    }
+
+    // One worker slot per remaining core (or per logical processor if workers use SMT).
+    for (u32 i{ first_worker_core }; i < cores.size(); ++i)
+    {
+        const core_info& c{ cores[i] };
+        if (settings.policy == placement_policy::core)
+        {
+            if (settings.workers_use_smt)
+            {
+                for (u32 j{ 0 }; j < c.count; ++j) add_worker(&core_processors[c.first + j], 1);
+            }
+            else add_worker(&core_processors[c.first], c.count);
+            continue;
+        }
+
+        // cache_group: all worker cores of the same cache group and efficiency class.
+        utl::vector<u32> group{};
+        for (u32 j{ first_worker_core }; j < cores.size(); ++j)
+        {
+            if (cores[j].cache_group == c.cache_group && cores[j].efficiency_class == c.efficiency_class)
+            {
+                add_core(group, cores[j], core_processors);
+            }
+        }
+
+        const u32 slots{ settings.workers_use_smt ? c.count : 1 };
+        for (u32 j{ 0 }; j < slots; ++j) add_worker(group.data(), (u32)group.size());
+    }
+
+    const u32 slot_count{ (u32)layout.worker_offsets.size() - 1 };
+    if (settings.worker_count) layout.worker_count = settings.worker_count;
+    else if (slot_count) layout.worker_count = slot_count;
+    else
+    {
+        // NOTE: all cores are used by the main and render threads. We still want workers,
+        //       but we leave them to the OS scheduler.
+        const u32 logical{ processor_count ? processor_count : std::thread::hardware_concurrency() };
+        layout.worker_count = logical > 1 ? std::max(1u, logical - 2) : 0;
+    }
+
+    // I/O threads mostly wait, so on hybrid CPUs they run on the slowest cores.
+    // Otherwise they share the worker cores.
+    utl::vector<u32>& io{ layout.processors[thread_role::io] };
+    if (topology.efficiency_class_count > 1)
+    {
+        for (const core_info& c : cores)
+        {
+            if (c.efficiency_class == 0) add_core(io, c, core_processors);
+        }
+    }
+    else
+    {
+        for (u32 i{ first_worker_core }; i < cores.size(); ++i) add_core(io, cores[i], core_processors);
+    }
+
+    layout.initialized = true;
+}
+
+bool
+is_initialized()
+{
+    return layout.initialized;
+}
+
+u32
+worker_count()
+{
+    return layout.worker_count;
+}
+
+bool
+apply(u32 role, u32 worker_index)
+{
+    assert(role < thread_role::count);
+    if (!layout.initialized || layout.settings.policy == placement_policy::none) return false;
+
+    if (role != thread_role::worker)
+    {
+        const utl::vector<u32>& processors{ layout.processors[role] };
+        return !processors.empty() && platform::set_thread_affinity(processors.data(), (u32)processors.size());
+    }
+
+    // NOTE: if more workers were requested than there are slots, they share the slots.
+    const u32 slot_count{ (u32)layout.worker_offsets.size() - 1 };
+    if (!slot_count) return false;
+    const u32 slot{ worker_index % slot_count };
+    const u32 first{ layout.worker_offsets[slot] };
+    return platform::set_thread_affinity(&layout.worker_processors[first], layout.worker_offsets[slot + 1] - first);
+}
+
+std::string
+report()
+{
+    const platform::cpu_topology& topology{ platform::get_cpu_topology() };
+    std::string text;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+             "CPU: %u logical processors, %u cores, %u cache groups (L%u, %llu KB), %u NUMA nodes, %u efficiency classes\n",
+             (u32)topology.processors.size(), topology.core_count, topology.cache_group_count, topology.cache_level,
+             (unsigned long long)(topology.cache_size >> 10), topology.numa_node_count, topology.efficiency_class_count);
+    text += buffer;
+    if (!layout.initialized) return text;
+
+    constexpr const char* policy_names[]{ "none", "cache group", "core" };
+    constexpr const char* role_names[thread_role::worker]{ "main", "render", "io" };
+    snprintf(buffer, sizeof(buffer), "Thread placement: %s, %u workers\n", policy_names[layout.settings.policy], layout.worker_count);
+    text += buffer;
+    for (u32 i{ 0 }; i < thread_role::worker; ++i)
+    {
+        const utl::vector<u32>& processors{ layout.processors[i] };
+        text += "  ";
+        text += role_names[i];
+        text += ": ";
+        text += to_ranges(processors.data(), (u32)processors.size());
+        text += "\n";
+    }
+
+    const u32 slot_count{ (u32)layout.worker_offsets.size() - 1 };
+    for (u32 i{ 0 }; i < layout.worker_count; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), "  worker %u: ", i);
+        text += buffer;
+        if (slot_count)
+        {
+            const u32 slot{ i % slot_count };
+            const u32 first{ layout.worker_offsets[slot] };
+            text += to_ranges(&layout.worker_processors[first], layout.worker_offsets[slot + 1] - first);
+        }
+        else text += "any";
+        text += "\n";
+    }
+
+    return text;
+}
+
+}
\ No newline at end of file
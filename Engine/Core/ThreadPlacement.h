@@ -0,0 +1,56 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <string>
+
+namespace primal::thread_placement {
+
+struct thread_role {
+    enum role : u32 {
+        main,
+        render,
+        io,
+        worker,
+
+        count
+    };
+};
+
+struct placement_policy {
+    enum policy : u32 {
+        // Threads aren't pinned. Only the number of workers is based on the topology.
+        none,
+        // The main and render threads are pinned to their own cores. Workers may run on any core of
+        // their cache group (e.g. a CCX), so they keep sharing its cache but the OS can still balance them.
+        cache_group,
+        // Like cache_group, but every worker is pinned to one core (or one logical processor if workers use SMT).
+        core,
+    };
+};
+
+struct config
+{
+    u32     policy{ placement_policy::cache_group };
+    // 0 means one worker per core that isn't used by the main or render thread.
+    u32     worker_count{ 0 };
+    // Run a worker on every logical processor of the worker cores instead of one per core.
+    bool    workers_use_smt{ false };
+    // The render thread gets a core that workers don't use. Otherwise, it shares the main thread's core.
+    bool    dedicated_render_core{ true };
+};
+
+// The main thread gets the fastest core (on CPUs with big and little cores) and the render thread
+// another fast core in the same cache group, because they share the frame snapshots. Workers are
+// spread over the remaining cores, filling one cache group after the other, fast cores first.
+// I/O threads mostly wait, so they run on the slowest cores (or on the worker cores if all cores
+// are the same).
+// NOTE: initialize() must be called before the engine threads are started (see jobs::initialize()).
+void initialize(const config& settings = {});
+[[nodiscard]] bool is_initialized();
+// Number of workers for jobs::initialize().
+[[nodiscard]] u32 worker_count();
+// Pins the calling thread according to its role. worker_index is only used by workers.
+// Does nothing if the placement wasn't initialized or if the policy is none.
+bool apply(u32 role, u32 worker_index = 0);
+// Returns the CPU topology and the chosen layout as text.
+[[nodiscard]] std::string report();
+}
\ No newline at end of file
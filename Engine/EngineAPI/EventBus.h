@@ -0,0 +1,104 @@
+#pragma once
+#include "GameEntity.h"
+
+namespace primal::event {
+
+DEFINE_TYPED_ID(subscription_id);
+
+// Events are plain structs that are copied with memcpy. They're appended to per-thread buffers
+// when they're posted and they're dispatched in batches, sorted by receiver, once per frame after
+// the scripts are updated. Events posted while dispatching are delivered in the next dispatch.
+//
+// There are two kinds of subscriptions:
+// - by type: the handler is called once per dispatch with all events of that type.
+//   This is the preferred way to handle high-volume events (e.g. damage or hits).
+// - by entity: the handler is called for every event of that type sent to the entity.
+//   These subscriptions are removed when the entity or its script is removed.
+template<typename T>
+using batch_handler = void(*)(void* context, const T* events, const game_entity::entity_id* receivers, u32 count);
+template<typename T>
+using entity_handler = void(*)(void* context, game_entity::entity_id receiver, const T& event);
+
+namespace detail {
+using handler_ptr = void(*)();
+using batch_trampoline = void(*)(handler_ptr, void*, const void*, const game_entity::entity_id*, u32);
+using entity_trampoline = void(*)(handler_ptr, void*, game_entity::entity_id, const void*);
+
+u32 register_event_type(u32 size);
+void post(u32 type, u32 size, game_entity::entity_id receiver, const void *const event);
+subscription_id subscribe(u32 type, handler_ptr handler, batch_trampoline trampoline, void* context);
+subscription_id subscribe(u32 type, game_entity::entity_id receiver, handler_ptr handler,
+                          entity_trampoline trampoline, void* context);
+
+template<typename T>
+u32
+event_type()
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Events are copied with memcpy.");
+    static const u32 type{ register_event_type(sizeof(T)) };
+    return type;
+}
+
+// NOTE: we call the handlers through these functions, so that they're
+//       called with the exact type they were declared with.
+template<typename T>
+void
+call_batch_handler(handler_ptr handler, void* context, const void* events, const game_entity::entity_id* receivers, u32 count)
+{
+    ((batch_handler<T>)handler)(context, (const T*)events, receivers, count);
+}
+
+template<typename T>
+void
+call_entity_handler(handler_ptr handler, void* context, game_entity::entity_id receiver, const void* event)
+{
+    ((entity_handler<T>)handler)(context, receiver, *(const T*)event);
+}
+} // namespace detail
+
+// Sends an event to an entity. It's safe to post events from any thread, also while the events
+// are dispatched. Subscribing and unsubscribing should only be done on the main thread.
+template<typename T>
+void
+post(game_entity::entity_id receiver, const T& event)
+{
+    detail::post(detail::event_type<T>(), sizeof(T), receiver, &event);
+}
+
+// Sends an event that doesn't have a receiver. Only type subscribers receive it.
+template<typename T>
+void
+broadcast(const T& event)
+{
+    detail::post(detail::event_type<T>(), sizeof(T), game_entity::entity_id{ id::invalid_id }, &event);
+}
+
+template<typename T>
+subscription_id
+subscribe(batch_handler<T> handler, void* context = nullptr)
+{
+    assert(handler);
+    return detail::subscribe(detail::event_type<T>(), (detail::handler_ptr)handler, &detail::call_batch_handler<T>, context);
+}
+
+template<typename T>
+subscription_id
+subscribe(game_entity::entity_id receiver, entity_handler<T> handler, void* context = nullptr)
+{
+    assert(handler && id::is_valid(receiver));
+    return detail::subscribe(detail::event_type<T>(), receiver, (detail::handler_ptr)handler, &detail::call_entity_handler<T>, context);
+}
+
+// Subscribes a member function of a script to the events of type T that are sent to its entity.
+// Example: event::subscribe<damage, my_script, &my_script::on_damage>(this);
+template<typename T, typename S, void(S::*method)(const T&)>
+subscription_id
+subscribe(S *const script)
+{
+    assert(script);
+    entity_handler<T> handler{ [](void* context, game_entity::entity_id, const T& event) { (static_cast<S*>(context)->*method)(event); } };
+    return subscribe<T>(script->get_id(), handler, script);
+}
+
+void unsubscribe(subscription_id id);
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "..\Components\ComponentsCommon.h"
 #include "TransfromComponent.h"
 #include "ScriptComponent.h"
+#include "ScriptCoroutine.h"
 
 namespace primal {
 namespace game_entity {
@@ -18,6 +19,11 @@ public:
 
     transform::component transform() const;
     script::component script() const;
+
+    void set_active(bool active) const;
+    bool is_active() const;
+    void set_static(bool is_static) const;
+    bool is_static() const;
 private:
     entity_id _id;
 };
@@ -29,11 +35,24 @@ class entity_script : public game_entity::entity
 {
 public:
     virtual ~entity_script() = default;
+    // Called once, after the script component was created and linked to the entity.
     virtual void begin_play() {}
     virtual void update(float) {}
+
+    // Override these to include the state of this script in world snapshots.
+    // save_state() writes exactly state_size() bytes, which restore_state() reads back.
+    virtual u32 state_size() const { return 0; }
+    virtual void save_state(u8*) const {}
+    virtual void restore_state(const u8*) {}
 protected:
     constexpr explicit entity_script(game_entity::entity entity)
         : game_entity::entity{ entity.get_id() } {}
+
+    // Starts a coroutine that's owned by this script. The coroutine runs immediately
+    // until it first suspends and it's cancelled when this script is removed.
+    // NOTE: don't call this from the constructor, because the script component
+    //       isn't linked to the entity at that point. Use begin_play() or update().
+    void start(task t) const { detail::start_task(std::move(t), *this); }
 };
 
 namespace detail {
@@ -79,4 +98,7 @@ u8 add_script_name(const char* name);
 #endif // USE_WITH_EDITOR
 } // namespace detail
 } // namespace script
-}
\ No newline at end of file
+}
+
+// NOTE: the event API uses entity ids, so we include it after they're declared.
+#include "EventBus.h"
\ No newline at end of file
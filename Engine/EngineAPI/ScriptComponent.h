@@ -5,6 +5,19 @@ namespace primal::script {
 
 DEFINE_TYPED_ID(script_id);
 
+// Specifies how often a script's update function is called. By default scripts are
+// updated every frame. Scripts with a lower update rate receive the accumulated
+// time since their last update as dt.
+struct update_rate
+{
+    static constexpr update_rate every_frame() { return {}; }
+    static constexpr update_rate every_n_frames(u32 n) { return { n, 0.f }; }
+    static constexpr update_rate every_seconds(f32 seconds) { return { 1, seconds }; }
+
+    u32 frames{ 1 };        // update every n frames (only used when interval is 0).
+    f32 interval{ 0.f };    // if not 0, update every 'interval' seconds instead.
+};
+
 class component final
 {
 public:
@@ -12,7 +25,11 @@ public:
     constexpr component() : _id{ id::invalid_id } {}
     constexpr script_id get_id() const { return _id; }
     constexpr bool is_valid() const { return id::is_valid(_id); }
-    
+
+    // NOTE: it's safe to change the update rate during script updates, for example
+    //       to lower it based on distance to the camera or importance of the entity.
+    void set_update_rate(update_rate rate) const;
+    update_rate get_update_rate() const;
 private:
     script_id _id;
 };
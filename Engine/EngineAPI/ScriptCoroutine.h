@@ -0,0 +1,131 @@
+#pragma once
+#include "..\Components\ComponentsCommon.h"
+#include <coroutine>
+#include <exception>
+
+namespace primal::game_entity {
+class entity;
+}
+
+namespace primal::script {
+
+class task;
+
+namespace detail {
+
+// State that the script scheduler keeps for every coroutine. Coroutines of the same
+// script are linked together, so they can be cancelled when the script is removed.
+struct task_state
+{
+    script_id   owner{ id::invalid_id };
+    task_state* prev{ nullptr };
+    task_state* next{ nullptr };
+    bool        cancelled{ false };
+};
+
+struct task_promise;
+using task_handle = std::coroutine_handle<task_promise>;
+
+// Coroutine frames are allocated from a pool with a few size classes,
+// so starting a coroutine doesn't need a heap allocation.
+void* allocate_task_frame(size_t size);
+void free_task_frame(void* frame, size_t size);
+
+void start_task(task&& t, const game_entity::entity& owner);
+void resume_next_frame(task_handle handle);
+void resume_after(task_handle handle, f32 seconds);
+void resume_when(task_handle handle, bool(*predicate)(void*), void* data);
+
+struct task_promise : task_state
+{
+    task get_return_object() noexcept;
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { assert(false); std::terminate(); }
+
+    static void* operator new(size_t size) { return allocate_task_frame(size); }
+    static void operator delete(void* frame, size_t size) { free_task_frame(frame, size); }
+};
+} // namespace detail
+
+// Return type of script coroutines. A task is started by calling entity_script::start().
+// After that, it's owned by the script scheduler and it's destroyed when it completes or
+// when the script that started it is removed.
+class task
+{
+public:
+    using promise_type = detail::task_promise;
+
+    constexpr task() = default;
+    constexpr explicit task(detail::task_handle handle) : _handle{ handle } {}
+    DISABLE_COPY(task);
+    task(task&& o) noexcept : _handle{ o._handle } { o._handle = nullptr; }
+    task& operator=(task&& o) noexcept
+    {
+        assert(this != &o);
+        if (this != &o)
+        {
+            if (_handle) _handle.destroy();
+            _handle = o._handle;
+            o._handle = nullptr;
+        }
+        return *this;
+    }
+
+    ~task() { if (_handle) _handle.destroy(); }
+
+    [[nodiscard]] constexpr bool is_valid() const { return (bool)_handle; }
+    [[nodiscard]] detail::task_handle release() { auto h{ _handle }; _handle = nullptr; return h; }
+
+private:
+    detail::task_handle _handle{};
+};
+
+inline task
+detail::task_promise::get_return_object() noexcept
+{
+    return task{ task_handle::from_promise(*this) };
+}
+
+// Awaitables that can be used in script coroutines.
+// A suspended coroutine isn't touched by the scheduler until it wakes up, except for
+// wait_until, whose predicate is evaluated once per frame.
+
+// Suspends the coroutine until the next frame.
+struct next_frame
+{
+    constexpr bool await_ready() const noexcept { return false; }
+    void await_suspend(detail::task_handle handle) const { detail::resume_next_frame(handle); }
+    constexpr void await_resume() const noexcept {}
+};
+
+// Suspends the coroutine for the specified time (in seconds).
+struct wait_seconds
+{
+    constexpr explicit wait_seconds(f32 seconds) : _seconds{ seconds } {}
+    constexpr bool await_ready() const noexcept { return _seconds <= 0.f; }
+    void await_suspend(detail::task_handle handle) const { detail::resume_after(handle, _seconds); }
+    constexpr void await_resume() const noexcept {}
+private:
+    f32 _seconds;
+};
+
+// Suspends the coroutine until the predicate returns true.
+template<typename predicate>
+struct wait_until
+{
+    constexpr explicit wait_until(predicate p) : _predicate{ std::move(p) } {}
+    bool await_ready() { return _predicate(); }
+    void await_suspend(detail::task_handle handle)
+    {
+        // NOTE: this awaiter lives in the coroutine frame while the coroutine is suspended,
+        //       so it's safe to pass its address to the scheduler.
+        detail::resume_when(handle, [](void* data) { return static_cast<wait_until*>(data)->_predicate(); }, this);
+    }
+    constexpr void await_resume() const noexcept {}
+private:
+    predicate _predicate;
+};
+
+}
\ No newline at end of file
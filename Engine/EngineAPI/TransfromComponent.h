@@ -16,6 +16,9 @@ public:
     math::v4 rotation() const;
     math::v3 position() const;
     math::v3 scale() const;
+    void set_rotation(math::v4 rotation) const;
+    void set_position(math::v3 position) const;
+    void set_scale(math::v3 scale) const;
 private:
     transform_id _id;
 };
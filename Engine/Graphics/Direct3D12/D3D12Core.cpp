@@ -3,6 +3,9 @@
 #include "D3D12Shaders.h"
 #include "D3D12GPass.h"
 #include "D3D12PostProcess.h"
+#include "Core\Metrics.h"
+#include "Core\Startup.h"
+#include "Utilities\Profiler.h"
 
 using namespace Microsoft::WRL;
 
@@ -183,7 +186,17 @@ namespace primal::graphics::d3d12::core {
 
         utl::vector<IUnknown*>          deferred_releases[frame_buffer_count]{};
         u32                             deferred_releases_flag[frame_buffer_count]{};
-        std::mutex                      deferred_releases_mutex{};
+        sync::mutex                     deferred_releases_mutex{ "deferred releases" };
+
+        // NOTE: the gauges are set on the thread that renders, because that's where
+        //       descriptors and deferred releases are processed.
+        metrics::metric_id              rtv_metric{ id::invalid_id };
+        metrics::metric_id              dsv_metric{ id::invalid_id };
+        metrics::metric_id              srv_metric{ id::invalid_id };
+        metrics::metric_id              uav_metric{ id::invalid_id };
+        metrics::metric_id              surfaces_metric{ id::invalid_id };
+        metrics::metric_id              pending_releases_metric{ id::invalid_id };
+        const metrics::metric_id        deferred_releases_metric{ metrics::register_counter("d3d12.deferred_releases") };
 
         constexpr D3D_FEATURE_LEVEL     minimum_feature_level{ D3D_FEATURE_LEVEL_11_0 };
 
@@ -255,6 +268,7 @@ namespace primal::graphics::d3d12::core {
             uav_desc_heap.process_deferred_free(frame_idx);
 
             utl::vector<IUnknown*>& resources{ deferred_releases[frame_idx] };
+            metrics::set(pending_releases_metric, (f64)resources.size());
             if (!resources.empty())
             {
                 for (auto& resource : resources) release(resource);
@@ -262,90 +276,126 @@ namespace primal::graphics::d3d12::core {
             }
         }
 
-    } // anonymous namespace
-
-    namespace detail {
-        void deferred_release(IUnknown* resource)
+        void
+            register_metrics()
         {
-            const u32 frame_idx{ current_frame_index() };
-            std::lock_guard lock{ deferred_releases_mutex };
-            deferred_releases[frame_idx].push_back(resource);
-            set_deferred_releases_flag();
+            rtv_metric = metrics::register_gauge("d3d12.rtv_descriptors", rtv_desc_heap.capacity());
+            dsv_metric = metrics::register_gauge("d3d12.dsv_descriptors", dsv_desc_heap.capacity());
+            srv_metric = metrics::register_gauge("d3d12.srv_descriptors", srv_desc_heap.capacity());
+            uav_metric = metrics::register_gauge("d3d12.uav_descriptors", uav_desc_heap.capacity());
+            surfaces_metric = metrics::register_gauge("d3d12.surfaces");
+            pending_releases_metric = metrics::register_gauge("d3d12.pending_deferred_releases");
         }
-    } // detail namespace
-
-    bool
-        initialize()
-    {
-        // determine what is the maximum feature level that is supported
-        // create a ID3D12Device (this a virtual adapter).
 
-        if (main_device) shutdown();
+        void
+            update_metrics()
+        {
+            metrics::set(rtv_metric, rtv_desc_heap.size());
+            metrics::set(dsv_metric, dsv_desc_heap.size());
+            metrics::set(srv_metric, srv_desc_heap.size());
+            metrics::set(uav_metric, uav_desc_heap.size());
+            metrics::set(surfaces_metric, surfaces.size());
+        }
 
-        u32 dxgi_factory_flags{ 0 };
-#ifdef _DEBUG
-        // Enable debugging layer. Requires "Graphics Tools" optional feature
+        // Creates the DXGI factory, the device, the descriptor heaps and the graphics command queue.
+        bool
+            create_device()
         {
-            ComPtr<ID3D12Debug3> debug_interface;
-            if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debug_interface))))
+            u32 dxgi_factory_flags{ 0 };
+#ifdef _DEBUG
+            // Enable debugging layer. Requires "Graphics Tools" optional feature
             {
-                debug_interface->EnableDebugLayer();
+                ComPtr<ID3D12Debug3> debug_interface;
+                if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debug_interface))))
+                {
+                    debug_interface->EnableDebugLayer();
 #if 0
 #pragma message("WARNING: GPU_based validation is enabled. This will considerably slow down the renderer!")
-                debug_interface->SetEnableGPUBasedValidation(1);
+                    debug_interface->SetEnableGPUBasedValidation(1);
 #endif
-            }
-            else
-            {
-                OutputDebugStringA("Warning: D3D12 Debug interface is not available. Verify that Graphics Tools optional feature is installed on this system.\n");
-            }
+                }
+                else
+                {
+                    OutputDebugStringA("Warning: D3D12 Debug interface is not available. Verify that Graphics Tools optional feature is installed on this system.\n");
+                }
 
-            dxgi_factory_flags |= DXGI_CREATE_FACTORY_DEBUG;
-        }
+                dxgi_factory_flags |= DXGI_CREATE_FACTORY_DEBUG;
+            }
 #endif // _DEBUG
 
-        HRESULT hr{ S_OK };
-        DXCall(hr = CreateDXGIFactory2(dxgi_factory_flags, IID_PPV_ARGS(&dxgi_factory)));
-        if (FAILED(hr)) return failed_init();
+            HRESULT hr{ S_OK };
+            DXCall(hr = CreateDXGIFactory2(dxgi_factory_flags, IID_PPV_ARGS(&dxgi_factory)));
+            if (FAILED(hr)) return false;
 
-        // determine which adapter (i.e. graphics card) to use, if any
-        ComPtr<IDXGIAdapter4> main_adapter;
-        main_adapter.Attach(determine_main_adapter());
-        if (!main_adapter) return failed_init();
+            // determine which adapter (i.e. graphics card) to use, if any
+            ComPtr<IDXGIAdapter4> main_adapter;
+            main_adapter.Attach(determine_main_adapter());
+            if (!main_adapter) return false;
 
-        D3D_FEATURE_LEVEL max_feature_level{ get_max_feature_level(main_adapter.Get()) };
-        assert(max_feature_level >= minimum_feature_level);
-        if (max_feature_level < minimum_feature_level) return failed_init();
+            D3D_FEATURE_LEVEL max_feature_level{ get_max_feature_level(main_adapter.Get()) };
+            assert(max_feature_level >= minimum_feature_level);
+            if (max_feature_level < minimum_feature_level) return false;
 
-        DXCall(hr = D3D12CreateDevice(main_adapter.Get(), max_feature_level, IID_PPV_ARGS(&main_device)));
-        if (FAILED(hr)) return failed_init();
+            DXCall(hr = D3D12CreateDevice(main_adapter.Get(), max_feature_level, IID_PPV_ARGS(&main_device)));
+            if (FAILED(hr)) return false;
 
 #ifdef _DEBUG
-        {
-            ComPtr<ID3D12InfoQueue> info_queue;
-            DXCall(main_device->QueryInterface(IID_PPV_ARGS(&info_queue)));
+            {
+                ComPtr<ID3D12InfoQueue> info_queue;
+                DXCall(main_device->QueryInterface(IID_PPV_ARGS(&info_queue)));
 
-            info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_CORRUPTION, true);
-            info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_WARNING, true);
-            info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_ERROR, true);
-        }
+                info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_CORRUPTION, true);
+                info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_WARNING, true);
+                info_queue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_ERROR, true);
+            }
 #endif // _DEBUG
 
-        bool result{ true };
-        result &= rtv_desc_heap.initialize(512, false);
-        result &= dsv_desc_heap.initialize(512, false);
-        result &= srv_desc_heap.initialize(4096, true);
-        result &= uav_desc_heap.initialize(512, false);
-        if (!result) return failed_init();
+            bool result{ true };
+            result &= rtv_desc_heap.initialize(512, false);
+            result &= dsv_desc_heap.initialize(512, false);
+            result &= srv_desc_heap.initialize(4096, true);
+            result &= uav_desc_heap.initialize(512, false);
+            if (!result) return false;
+
+            new (&gfx_command) d3d12_command(main_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+            if (!gfx_command.command_queue()) return false;
+            return true;
+        }
+
+    } // anonymous namespace
+
+    namespace detail {
+        void deferred_release(IUnknown* resource)
+        {
+            const u32 frame_idx{ current_frame_index() };
+            std::lock_guard lock{ deferred_releases_mutex };
+            deferred_releases[frame_idx].push_back(resource);
+            set_deferred_releases_flag();
+            metrics::add(deferred_releases_metric);
+        }
+    } // detail namespace
+
+    bool
+        initialize()
+    {
+        // determine what is the maximum feature level that is supported
+        // create a ID3D12Device (this a virtual adapter).
 
-        new (&gfx_command) d3d12_command(main_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
-        if (!gfx_command.command_queue()) return failed_init();
+        if (main_device) shutdown();
 
-        // initialize modules
-        if (!(shaders::initialize() &&
-              gpass::initialize() &&
-              fx::initialize()))
-            return failed_init();
+        // create the device and initialize modules
+        // NOTE: the engine shaders are loaded while the device is created. The gpass and
+        //       post-process pipeline states need both and are created in parallel.
+        using namespace primal::startup;
+        init_graph startup{};
+        task_info device_task{ "d3d12 device", [](void*) { return create_device(); } };
+        task_info shaders_task{ "load engine shaders", [](void*) { return shaders::initialize(); } };
+        const task_id dependencies[]{ startup.add_task(device_task), startup.add_task(shaders_task) };
+        task_info gpass_task{ "gpass", [](void*) { return gpass::initialize(); }, nullptr, &dependencies[0], _countof(dependencies) };
+        task_info fx_task{ "post-process", [](void*) { return fx::initialize(); }, nullptr, &dependencies[0], _countof(dependencies) };
+        startup.add_task(gpass_task);
+        startup.add_task(fx_task);
+        if (!startup.run()) return failed_init();
 
         NAME_D3D12_OBJECT(main_device, L"Main D3D12 Device");
         NAME_D3D12_OBJECT(rtv_desc_heap.heap(), L"RTV Descriptor Heap");
@@ -353,6 +403,7 @@ namespace primal::graphics::d3d12::core {
         NAME_D3D12_OBJECT(srv_desc_heap.heap(), L"SRV Descriptor Heap");
         NAME_D3D12_OBJECT(uav_desc_heap.heap(), L"UAV Descriptor Heap");
 
+        register_metrics();
         return true;
     }
 
@@ -472,6 +523,7 @@ namespace primal::graphics::d3d12::core {
     void
         render_surface(surface_id id)
     {
+        PROFILE_SCOPE("d3d12::render_surface");
         // Wait for the GPU to finish with the command allocator and
         // reset the allocator once the GPU is done with it.
         // This frees the memory that was used to store commands.
@@ -483,6 +535,12 @@ namespace primal::graphics::d3d12::core {
         {
             process_deferred_releases(frame_idx);
         }
+        else
+        {
+            metrics::set(pending_releases_metric, 0.0);
+        }
+
+        update_metrics();
 
         const d3d12_surface& surface{ surfaces[id] };
         ID3D12Resource *const current_back_buffer{ surface.back_buffer() };
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12CommonHeaders.h"
+#include "Core\Mutex.h"
 
 namespace primal::graphics::d3d12 {
 
@@ -23,7 +24,7 @@ namespace primal::graphics::d3d12 {
     class descriptor_heap
     {
     public:
-        explicit descriptor_heap(D3D12_DESCRIPTOR_HEAP_TYPE type) : _type{ type } {}
+        explicit descriptor_heap(D3D12_DESCRIPTOR_HEAP_TYPE type) : _mutex{ lock_name(type) }, _type{ type } {}
         DISABLE_COPY_AND_MOVE(descriptor_heap);
         ~descriptor_heap() { assert(!_heap); }
 
@@ -44,12 +45,23 @@ namespace primal::graphics::d3d12 {
         [[nodiscard]] constexpr bool is_shader_visible() const { return _gpu_start.ptr != 0; }
 
     private:
+        [[nodiscard]] constexpr static const char* lock_name(D3D12_DESCRIPTOR_HEAP_TYPE type)
+        {
+            switch (type)
+            {
+            case D3D12_DESCRIPTOR_HEAP_TYPE_RTV: return "rtv descriptor heap";
+            case D3D12_DESCRIPTOR_HEAP_TYPE_DSV: return "dsv descriptor heap";
+            case D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER: return "sampler descriptor heap";
+            default: return "cbv_srv_uav descriptor heap";
+            }
+        }
+
         ID3D12DescriptorHeap*               _heap;
         D3D12_CPU_DESCRIPTOR_HANDLE         _cpu_start{};
         D3D12_GPU_DESCRIPTOR_HANDLE         _gpu_start{};
         std::unique_ptr<u32[]>              _free_handles{};
         utl::vector<u32>                    _deferred_free_indices[frame_buffer_count]{};
-        std::mutex                          _mutex{};
+        sync::mutex                         _mutex;
         u32                                 _capacity{ 0 };
         u32                                 _size{ 0 };
         u32                                 _descriptor_size{};
@@ -1,7 +1,9 @@
 #include "Renderer.h"
 #include "GraphicsPlatformInterface.h"
 #include "Direct3D12\D3D12Interface.h"
-
+#include "Core\Metrics.h"
+#include <atomic>
+#include <thread>
 
 namespace primal::graphics {
 namespace {
@@ -14,6 +16,147 @@ constexpr const char* engine_shader_paths[]{
 
 platform_interface gfx{};
 
+struct command_type {
+    enum type : u32 {
+        create_surface,
+        remove_surface,
+        resize_surface,
+    };
+};
+
+struct render_command
+{
+    u32                     type;
+    surface_id              id;
+    platform::window_id     window;
+    u32                     width;
+    u32                     height;
+    surface_created         callback;
+    void*                   context;
+};
+
+// Bounded multi-producer/single-consumer queue. Every cell has a sequence number that tells
+// whether it can be written (sequence == position) or read (sequence == position + 1).
+// Producers claim a position with a CAS on the tail, so posting never takes a lock.
+// NOTE: only the thread that processes the commands may pop.
+class command_queue
+{
+public:
+    constexpr static u32 capacity{ 256 };
+
+    command_queue()
+    {
+        for (u32 i{ 0 }; i < capacity; ++i) _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool push(const render_command& command)
+    {
+        u32 position{ _tail.load(std::memory_order_relaxed) };
+        for (;;)
+        {
+            cell& c{ _cells[position & mask] };
+            const u32 sequence{ c.sequence.load(std::memory_order_acquire) };
+            const s32 difference{ (s32)(sequence - position) };
+            if (difference == 0)
+            {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    c.command = command;
+                    c.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) return false; // the queue is full.
+            else position = _tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] bool pop(render_command& command)
+    {
+        cell& c{ _cells[_head & mask] };
+        if (c.sequence.load(std::memory_order_acquire) != _head + 1) return false;
+        command = c.command;
+        c.sequence.store(_head + capacity, std::memory_order_release);
+        ++_head;
+        return true;
+    }
+
+private:
+    constexpr static u32 mask{ capacity - 1 };
+    static_assert((capacity & mask) == 0, "The capacity must be a power of 2.");
+
+    struct cell
+    {
+        std::atomic<u32>    sequence;
+        render_command      command;
+    };
+
+    cell                            _cells[capacity];
+    alignas(64) std::atomic<u32>    _tail{ 0 };
+    alignas(64) u32                 _head{ 0 };
+};
+
+command_queue                   commands{};
+// Only used by the thread that processes the commands.
+utl::vector<render_command>     batch;
+bool                            is_processing{ false };
+// The thread that processes the commands can't wait for itself when the queue is full.
+thread_local bool               is_command_thread{ false };
+
+const metrics::metric_id        commands_metric{ metrics::register_counter("graphics.render_commands") };
+const metrics::metric_id        coalesced_metric{ metrics::register_counter("graphics.coalesced_render_commands") };
+const metrics::metric_id        stalls_metric{ metrics::register_counter("graphics.render_command_stalls") };
+
+void
+post(const render_command& command)
+{
+    if (commands.push(command)) return;
+
+    // Back-pressure: wait until the render loop has processed some commands.
+    metrics::add(stalls_metric);
+    while (!commands.push(command))
+    {
+        if (is_command_thread) process_commands();
+        else std::this_thread::yield();
+    }
+}
+
+bool
+contains(const utl::vector<surface_id>& ids, surface_id id)
+{
+    for (const surface_id i : ids)
+    {
+        if (i == id) return true;
+    }
+
+    return false;
+}
+
+// Drops the commands that are overridden by later ones: resizes that are followed by
+// another resize or by the removal of the same surface, and repeated removals.
+u32
+coalesce(utl::vector<render_command>& commands)
+{
+    utl::vector<surface_id> resized;
+    utl::vector<surface_id> removed;
+    u32 dropped{ 0 };
+    for (u32 i{ (u32)commands.size() }; i > 0; --i)
+    {
+        render_command& command{ commands[i - 1] };
+        if (command.type == command_type::create_surface) continue;
+
+        utl::vector<surface_id>& seen{ command.type == command_type::resize_surface ? resized : removed };
+        if (contains(removed, command.id) || contains(seen, command.id))
+        {
+            command.id = surface_id{ id::invalid_id };
+            ++dropped;
+        }
+        else seen.emplace_back(command.id);
+    }
+
+    return dropped;
+}
+
 bool
 set_platform_interface(graphics_platform platform)
 {
@@ -41,7 +184,12 @@ initialize(graphics_platform platform)
 void
 shutdown()
 {
-    if (gfx.platform != (graphics_platform)-1) gfx.shutdown();
+    if (gfx.platform != (graphics_platform)-1)
+    {
+        // NOTE: apply the remaining commands, so that the surfaces that were posted for removal are removed.
+        process_commands();
+        gfx.shutdown();
+    }
 }
 
 const char*
@@ -69,6 +217,70 @@ remove_surface(surface_id id)
     gfx.surface.remove(id);
 }
 
+void
+post_create_surface(platform::window window, surface_created callback, void* context)
+{
+    assert(window.is_valid() && callback);
+    post({ command_type::create_surface, surface_id{ id::invalid_id }, window.get_id(), 0, 0, callback, context });
+}
+
+void
+post_remove_surface(surface_id id)
+{
+    assert(id::is_valid(id));
+    post({ command_type::remove_surface, id, platform::window_id{ id::invalid_id }, 0, 0, nullptr, nullptr });
+}
+
+void
+post_resize_surface(surface_id id, u32 width, u32 height)
+{
+    assert(id::is_valid(id));
+    post({ command_type::resize_surface, id, platform::window_id{ id::invalid_id }, width, height, nullptr, nullptr });
+}
+
+u32
+process_commands()
+{
+    is_command_thread = true;
+    render_command command;
+    if (is_processing)
+    {
+        // NOTE: a callback posted commands while the queue was full. We make room by moving
+        //       the commands to the batch, which is still being processed.
+        while (commands.pop(command)) batch.emplace_back(command);
+        return 0;
+    }
+
+    batch.clear();
+    while (commands.pop(command)) batch.emplace_back(command);
+    if (batch.empty()) return 0;
+
+    is_processing = true;
+    const u32 dropped{ coalesce(batch) };
+    for (u32 i{ 0 }; i < batch.size(); ++i)
+    {
+        // NOTE: the batch can grow while we're processing it (see above), so we copy the command.
+        const render_command c{ batch[i] };
+        switch (c.type)
+        {
+        case command_type::create_surface:
+            c.callback(create_surface(platform::window{ c.window }), c.context);
+            break;
+        case command_type::remove_surface:
+            if (id::is_valid(c.id)) remove_surface(c.id);
+            break;
+        case command_type::resize_surface:
+            if (id::is_valid(c.id)) surface{ c.id }.resize(c.width, c.height);
+            break;
+        }
+    }
+
+    is_processing = false;
+    metrics::add(commands_metric, (s64)batch.size());
+    metrics::add(coalesced_metric, dropped);
+    return (u32)batch.size() - dropped;
+}
+
 void
 surface::resize(u32 width, u32 height) const
 {
@@ -44,6 +44,21 @@ const char* get_engine_shaders_path();
 // The path is for the graphics API that's currently in use.
 const char* get_engine_shaders_path(graphics_platform platform);
 
+// NOTE: these take effect immediately, so they must be called from the thread that renders.
+//       Other threads post render commands instead (see below).
 surface create_surface(platform::window window);
 void remove_surface(surface_id id);
+
+// Render commands can be posted from any thread without taking a lock. They're stored in a bounded
+// queue and applied in order when the render loop calls process_commands() at the start of its frame.
+// Commands that are overridden by later ones are dropped (e.g. only the last resize of a surface is
+// applied). If the queue is full, the posting thread waits until the commands are processed.
+using surface_created = void(*)(surface created, void* context);
+
+// The callback is called with the new surface on the thread that processes the commands.
+void post_create_surface(platform::window window, surface_created callback, void* context = nullptr);
+void post_remove_surface(surface_id id);
+void post_resize_surface(surface_id id, u32 width, u32 height);
+// Returns the number of commands that were applied.
+u32 process_commands();
 }
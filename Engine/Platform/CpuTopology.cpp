@@ -0,0 +1,367 @@
+#include "CpuTopology.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN64
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // !WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#endif // _WIN64
+
+namespace primal::platform {
+
+    namespace {
+
+        constexpr u64 unknown_key{ ~0ull };
+
+        // What we know about a processor before the cores, caches and nodes are numbered.
+        // The keys only have to be equal for processors that share the same core, cache, etc.
+        struct raw_processor
+        {
+            u32 index;
+            u64 core_key{ unknown_key };
+            u64 cache_key{ unknown_key };
+            u64 numa_key{ 0 };
+            u64 efficiency_key{ 0 };
+        };
+
+        struct raw_topology
+        {
+            utl::vector<raw_processor>  processors;
+            u32                         cache_level{ 0 };
+            u64                         cache_size{ 0 };
+
+            raw_processor* find(u32 index)
+            {
+                for (auto& p : processors) if (p.index == index) return &p;
+                return nullptr;
+            }
+        };
+
+#ifdef _WIN64
+        template<typename F>
+        void
+            for_each_processor(const GROUP_AFFINITY& affinity, F&& f)
+        {
+            for (u32 bit{ 0 }; bit < 64; ++bit)
+            {
+                if (affinity.Mask & (1ull << bit)) f(affinity.Group * 64u + bit);
+            }
+        }
+
+        bool
+            query_topology(raw_topology& topology)
+        {
+            DWORD length{ 0 };
+            GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+            if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || !length) return false;
+
+            std::unique_ptr<u8[]> buffer{ new u8[length] };
+            if (!GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.get(), &length)) return false;
+
+            // NOTE: the entries have different sizes, so we have to walk them using their Size field.
+            const auto for_each_entry = [&buffer, length](auto&& f)
+            {
+                for (DWORD offset{ 0 }; offset < length;)
+                {
+                    const auto* info{ (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.get() + offset) };
+                    f(*info);
+                    offset += info->Size;
+                }
+            };
+
+            u64 core{ 0 };
+            for_each_entry([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info)
+                           {
+                               if (info.Relationship != RelationProcessorCore) return;
+                               for (WORD g{ 0 }; g < info.Processor.GroupCount; ++g)
+                               {
+                                   for_each_processor(info.Processor.GroupMask[g], [&](u32 index)
+                                                      {
+                                                          raw_processor& p{ topology.processors.emplace_back() };
+                                                          p.index = index;
+                                                          p.core_key = core;
+                                                          p.efficiency_key = info.Processor.EfficiencyClass;
+                                                      });
+                               }
+                               ++core;
+                           });
+
+            // The cache groups are defined by the largest unified (or data) cache level.
+            for_each_entry([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info)
+                           {
+                               if (info.Relationship == RelationCache && info.Cache.Type != CacheInstruction &&
+                                   info.Cache.Level > topology.cache_level)
+                               {
+                                   topology.cache_level = info.Cache.Level;
+                                   topology.cache_size = info.Cache.CacheSize;
+                               }
+                           });
+
+            u64 cache{ 0 };
+            for_each_entry([&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info)
+                           {
+                               if (info.Relationship == RelationCache && info.Cache.Type != CacheInstruction &&
+                                   info.Cache.Level == topology.cache_level)
+                               {
+                                   for_each_processor(info.Cache.GroupMask, [&](u32 index)
+                                                      {
+                                                          if (raw_processor* p{ topology.find(index) }) p->cache_key = cache;
+                                                      });
+                                   ++cache;
+                               }
+                               else if (info.Relationship == RelationNumaNode)
+                               {
+                                   for_each_processor(info.NumaNode.GroupMask, [&](u32 index)
+                                                      {
+                                                          if (raw_processor* p{ topology.find(index) }) p->numa_key = info.NumaNode.NodeNumber;
+                                                      });
+                               }
+                           });
+
+            return !topology.processors.empty();
+        }
+#elif defined(__linux__)
+        bool
+            read_text(const std::filesystem::path& path, std::string& text)
+        {
+            std::ifstream file{ path };
+            if (!file) return false;
+            std::getline(file, text);
+            return true;
+        }
+
+        bool
+            read_number(const std::filesystem::path& path, u64& value)
+        {
+            std::string text;
+            if (!read_text(path, text) || text.empty()) return false;
+            value = strtoull(text.c_str(), nullptr, 10);
+            return true;
+        }
+
+        // Parses lists like "0-3,8-11".
+        void
+            parse_cpu_list(const std::string& text, utl::vector<u32>& cpus)
+        {
+            const char* at{ text.c_str() };
+            while (*at)
+            {
+                char* end{ nullptr };
+                const u32 first{ (u32)strtoul(at, &end, 10) };
+                if (end == at) break;
+                u32 last{ first };
+                at = end;
+                if (*at == '-')
+                {
+                    last = (u32)strtoul(at + 1, &end, 10);
+                    at = end;
+                }
+
+                for (u32 cpu{ first }; cpu <= last; ++cpu) cpus.emplace_back(cpu);
+                if (*at == ',') ++at;
+                else break;
+            }
+        }
+
+        bool
+            query_topology(raw_topology& topology)
+        {
+            namespace fs = std::filesystem;
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed)) return false;
+
+            const fs::path root{ "/sys/devices/system/cpu" };
+            std::error_code error;
+            if (!fs::exists(root, error)) return false;
+
+            for (u32 cpu{ 0 }; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (!CPU_ISSET(cpu, &allowed)) continue;
+                const fs::path dir{ root / ("cpu" + std::to_string(cpu)) };
+                raw_processor& p{ topology.processors.emplace_back() };
+                p.index = cpu;
+
+                u64 package{ 0 }, core{ 0 };
+                if (read_number(dir / "topology" / "core_id", core))
+                {
+                    read_number(dir / "topology" / "physical_package_id", package);
+                    p.core_key = (package << 32) | core;
+                }
+
+                // Big and little cores have different capacities (ARM) or maximum frequencies (x86 hybrid CPUs).
+                if (!read_number(dir / "cpu_capacity", p.efficiency_key))
+                {
+                    read_number(dir / "cpufreq" / "cpuinfo_max_freq", p.efficiency_key);
+                }
+
+                // The key of a cache group is the first processor that shares the cache.
+                for (u32 i{ 0 }; ; ++i)
+                {
+                    const fs::path cache{ dir / "cache" / ("index" + std::to_string(i)) };
+                    u64 level{ 0 };
+                    if (!read_number(cache / "level", level)) break;
+                    std::string type, shared;
+                    read_text(cache / "type", type);
+                    if (type == "Instruction" || level < topology.cache_level || !read_text(cache / "shared_cpu_list", shared)) continue;
+
+                    utl::vector<u32> cpus;
+                    parse_cpu_list(shared, cpus);
+                    if (cpus.empty()) continue;
+                    if (level > topology.cache_level)
+                    {
+                        // A higher level than we've seen on any processor so far: forget the lower levels.
+                        topology.cache_level = (u32)level;
+                        for (auto& other : topology.processors) other.cache_key = unknown_key;
+                        std::string size;
+                        if (read_text(cache / "size", size))
+                        {
+                            char* unit{ nullptr };
+                            topology.cache_size = strtoull(size.c_str(), &unit, 10);
+                            if (*unit == 'K') topology.cache_size <<= 10;
+                            else if (*unit == 'M') topology.cache_size <<= 20;
+                        }
+                    }
+                    p.cache_key = cpus[0];
+                }
+            }
+
+            for (const auto& entry : fs::directory_iterator{ "/sys/devices/system/node", error })
+            {
+                const std::string name{ entry.path().filename().string() };
+                if (name.compare(0, 4, "node") || name.size() == 4 || !isdigit((u8)name[4])) continue;
+                std::string list;
+                if (!read_text(entry.path() / "cpulist", list)) continue;
+                utl::vector<u32> cpus;
+                parse_cpu_list(list, cpus);
+                const u64 node{ strtoull(name.c_str() + 4, nullptr, 10) };
+                for (const u32 cpu : cpus)
+                {
+                    if (raw_processor* p{ topology.find(cpu) }) p->numa_key = node;
+                }
+            }
+
+            return !topology.processors.empty();
+        }
+#else
+        bool
+            query_topology(raw_topology&)
+        {
+            return false;
+        }
+#endif // _WIN64
+
+        // Replaces the keys with consecutive numbers in the order in which they first appear.
+        template<typename F>
+        u32
+            number_keys(const utl::vector<raw_processor>& raw, utl::vector<logical_processor>& processors, F&& key, u32 logical_processor::* member)
+        {
+            utl::vector<u64> keys;
+            for (u32 i{ 0 }; i < raw.size(); ++i)
+            {
+                const u64 k{ key(raw[i]) };
+                u32 number{ 0 };
+                while (number < keys.size() && keys[number] != k) ++number;
+                if (number == keys.size()) keys.emplace_back(k);
+                processors[i].*member = number;
+            }
+
+            return (u32)keys.size();
+        }
+
+        cpu_topology
+            create_topology()
+        {
+            raw_topology raw{};
+            if (!query_topology(raw))
+            {
+                raw = {};
+                const u32 count{ std::max(std::thread::hardware_concurrency(), 1u) };
+                for (u32 i{ 0 }; i < count; ++i) raw.processors.emplace_back().index = i;
+            }
+
+            std::sort(raw.processors.begin(), raw.processors.end(),
+                      [](const raw_processor& a, const raw_processor& b) { return a.index < b.index; });
+
+            cpu_topology topology{};
+            const u32 count{ (u32)raw.processors.size() };
+            topology.processors.resize(count);
+            for (u32 i{ 0 }; i < count; ++i) topology.processors[i].index = raw.processors[i].index;
+
+            // NOTE: processors without a known core are their own core, and processors without a known
+            //       cache group share one group (i.e. we don't know of any cache boundaries).
+            topology.core_count = number_keys(raw.processors, topology.processors,
+                                              [](const raw_processor& p) { return p.core_key != unknown_key ? p.core_key : (1ull << 63) | p.index; },
+                                              &logical_processor::core);
+            topology.cache_group_count = number_keys(raw.processors, topology.processors,
+                                                     [](const raw_processor& p) { return p.cache_key; }, &logical_processor::cache_group);
+            topology.numa_node_count = number_keys(raw.processors, topology.processors,
+                                                   [](const raw_processor& p) { return p.numa_key; }, &logical_processor::numa_node);
+            topology.cache_level = raw.cache_level;
+            topology.cache_size = raw.cache_size;
+
+            // Efficiency classes are ranked, so that the slowest class is 0.
+            utl::vector<u64> classes;
+            for (const auto& p : raw.processors)
+            {
+                if (std::find(classes.begin(), classes.end(), p.efficiency_key) == classes.end()) classes.emplace_back(p.efficiency_key);
+            }
+            std::sort(classes.begin(), classes.end());
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                topology.processors[i].efficiency_class =
+                    (u32)(std::find(classes.begin(), classes.end(), raw.processors[i].efficiency_key) - classes.begin());
+            }
+            topology.efficiency_class_count = (u32)classes.size();
+
+            return topology;
+        }
+
+    } // anonymous namespace
+
+    const cpu_topology&
+        get_cpu_topology()
+    {
+        static const cpu_topology topology{ create_topology() };
+        return topology;
+    }
+
+    bool
+        set_thread_affinity(const u32 *const processors, u32 count)
+    {
+        assert(processors && count);
+        if (!processors || !count) return false;
+#ifdef _WIN64
+        GROUP_AFFINITY affinity{};
+        affinity.Group = (WORD)(processors[0] / 64);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            assert(processors[i] / 64 == affinity.Group);
+            if (processors[i] / 64 == affinity.Group) affinity.Mask |= 1ull << (processors[i] % 64);
+        }
+
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            if (processors[i] < CPU_SETSIZE) CPU_SET(processors[i], &set);
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        return false;
+#endif // _WIN64
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace primal::platform {
+
+struct logical_processor
+{
+    u32 index;              // the OS processor number (used for affinity masks).
+    u32 core;               // index of the physical core. SMT siblings share their core.
+    u32 cache_group;        // index of the group of processors that share the last-level cache (e.g. a CCX).
+    u32 numa_node;
+    u32 efficiency_class;   // 0 is the slowest class (e.g. little cores). All cores are 0 on homogeneous CPUs.
+};
+
+struct cpu_topology
+{
+    utl::vector<logical_processor>  processors;     // sorted by index.
+    u32                             core_count{ 0 };
+    u32                             cache_group_count{ 0 };
+    u32                             numa_node_count{ 0 };
+    u32                             efficiency_class_count{ 0 };
+    u32                             cache_level{ 0 };       // level of the cache that defines the cache groups (0 if unknown).
+    u64                             cache_size{ 0 };        // size of one of those caches in bytes.
+};
+
+// Returns the topology of the processors that this process may run on. It's queried on first use.
+// On Windows, it comes from GetLogicalProcessorInformationEx() and on Linux from /sys/devices/system/cpu.
+// If the topology can't be queried, every logical processor is treated as its own core.
+const cpu_topology& get_cpu_topology();
+
+// Restricts the calling thread to the given logical processors (see logical_processor::index).
+// NOTE: on Windows, all processors have to be in the same processor group.
+bool set_thread_affinity(const u32 *const processors, u32 count);
+}
\ No newline at end of file
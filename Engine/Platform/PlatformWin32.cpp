@@ -1,6 +1,7 @@
 #ifdef _WIN64
 #include "Platform.h"
 #include "PlatformTypes.h"
+#include "..\Core\Metrics.h"
 
 namespace primal::platform {
 
@@ -18,6 +19,9 @@ namespace primal::platform {
 
         utl::free_list<window_info> windows;
 
+        const metrics::metric_id windows_metric{ metrics::register_gauge("platform.windows", 0.0,
+                                                     [](void*) { return (f64)windows.size(); }) };
+
         window_info&
             get_from_id(window_id id)
         {
@@ -0,0 +1,353 @@
+#pragma once
+#include "CommonHeaders.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace primal::utl {
+
+// Distribution of frame (or stage) times over the rolling window. Percentiles use the nearest rank.
+struct time_distribution
+{
+    u32 count;
+    f64 average_ms;
+    f64 p50_ms;
+    f64 p90_ms;
+    f64 p99_ms;
+    f64 p999_ms;
+    f64 max_ms;
+};
+
+// Collects frame times with nanosecond resolution. The last window_size frames are kept for
+// percentiles and CSV export, while the log-bucketed histogram and the hitch count cover all
+// frames since the last reset(). Stages (e.g. scripts or render submission) are optional and
+// give a per-stage breakdown of every frame.
+//
+// Usage:
+//     stats.set_stage_time(scripts, ns);   // any number of times per frame
+//     stats.end_frame();                   // or record_frame(ns) if the frame was timed elsewhere
+class frame_statistics
+{
+public:
+    // The histogram has 4 buckets per power of two microseconds, so the relative error of a
+    // bucket is at most 25%. Frame times are clamped to 2^32 microseconds (about 71 minutes).
+    constexpr static u32 sub_buckets{ 4 };
+    constexpr static u32 bucket_count{ 31 * sub_buckets };
+    constexpr static u32 max_hitches{ 64 };
+
+    struct hitch
+    {
+        u64 frame;          // frame number since the last reset.
+        u64 duration_ns;
+        u32 slowest_stage;  // u32_invalid_id if there are no stages.
+    };
+
+    explicit frame_statistics(u32 window_size = 1024, f64 hitch_threshold_ms = 33.3)
+        : _hitch_threshold_ns{ (u64)(hitch_threshold_ms * 1e6) }, _window_size{ window_size }
+    {
+        assert(window_size);
+        _frames.resize(window_size, 0);
+    }
+
+    DISABLE_COPY_AND_MOVE(frame_statistics);
+
+    // Returns the index of the stage. Stages can be added at any time, but the frames that
+    // were recorded before have a duration of 0 for them.
+    // NOTE: the name must be a string literal (or live as long as the statistics).
+    u32 add_stage(const char* name)
+    {
+        assert(name);
+        _stage_names.emplace_back(name);
+        _stage_ns.resize(_stage_ns.size() + _window_size, 0);
+        _current_stage_ns.emplace_back(0);
+        return stage_count() - 1;
+    }
+
+    void set_hitch_threshold(f64 milliseconds)
+    {
+        _hitch_threshold_ns = (u64)(milliseconds * 1e6);
+    }
+
+    // Adds to the time of a stage in the current frame.
+    void add_stage_time(u32 stage, u64 nanoseconds)
+    {
+        assert(stage < stage_count());
+        _current_stage_ns[stage] += nanoseconds;
+    }
+
+    void set_stage_time(u32 stage, u64 nanoseconds)
+    {
+        assert(stage < stage_count());
+        _current_stage_ns[stage] = nanoseconds;
+    }
+
+    // Records the time since the last call as the duration of a frame. The first call only starts the clock.
+    void end_frame()
+    {
+        const clock::time_point now{ clock::now() };
+        if (_last_end != clock::time_point{})
+        {
+            record_frame((u64)std::chrono::duration_cast<std::chrono::nanoseconds>(now - _last_end).count());
+        }
+        else
+        {
+            for (u64& ns : _current_stage_ns) ns = 0;
+        }
+        _last_end = now;
+    }
+
+    void record_frame(u64 nanoseconds)
+    {
+        const u32 slot{ (u32)(_frame_count % _window_size) };
+        _frames[slot] = nanoseconds;
+
+        u32 slowest{ u32_invalid_id };
+        for (u32 i{ 0 }; i < stage_count(); ++i)
+        {
+            _stage_ns[i * _window_size + slot] = _current_stage_ns[i];
+            if (slowest == u32_invalid_id || _current_stage_ns[i] > _current_stage_ns[slowest]) slowest = i;
+            _current_stage_ns[i] = 0;
+        }
+
+        ++_histogram[bucket(nanoseconds)];
+        if (nanoseconds > _max_ns) _max_ns = nanoseconds;
+        if (_hitch_threshold_ns && nanoseconds > _hitch_threshold_ns)
+        {
+            _hitches[_hitch_count % max_hitches] = hitch{ _frame_count, nanoseconds, slowest };
+            ++_hitch_count;
+        }
+
+        ++_frame_count;
+    }
+
+    void reset()
+    {
+        for (u64& ns : _current_stage_ns) ns = 0;
+        memset(_histogram, 0, sizeof(_histogram));
+        _frame_count = 0;
+        _hitch_count = 0;
+        _max_ns = 0;
+        _last_end = {};
+    }
+
+    [[nodiscard]] time_distribution frame_distribution() const
+    {
+        return distribution(_frames.data());
+    }
+
+    [[nodiscard]] time_distribution stage_distribution(u32 stage) const
+    {
+        assert(stage < stage_count());
+        return distribution(&_stage_ns[stage * _window_size]);
+    }
+
+    [[nodiscard]] u32 stage_count() const { return (u32)_stage_names.size(); }
+    [[nodiscard]] const char* stage_name(u32 stage) const { assert(stage < stage_count()); return _stage_names[stage]; }
+    [[nodiscard]] u64 frame_count() const { return _frame_count; }
+    // Longest frame since the last reset (the distributions only cover the window).
+    [[nodiscard]] f64 max_ms() const { return _max_ns * 1e-6; }
+    [[nodiscard]] u64 hitch_count() const { return _hitch_count; }
+    [[nodiscard]] u64 histogram_count(u32 bucket) const { assert(bucket < bucket_count); return _histogram[bucket]; }
+
+    // The last max_hitches hitches, oldest first.
+    [[nodiscard]] u32 get_hitches(hitch *const hitches) const
+    {
+        const u32 count{ _hitch_count < max_hitches ? (u32)_hitch_count : max_hitches };
+        if (!hitches) return count;
+        const u64 first{ _hitch_count - count };
+        for (u32 i{ 0 }; i < count; ++i) hitches[i] = _hitches[(first + i) % max_hitches];
+        return count;
+    }
+
+    // Lowest frame time of a histogram bucket in microseconds.
+    [[nodiscard]] constexpr static u64 bucket_lower_bound_us(u32 bucket)
+    {
+        if (bucket < sub_buckets) return bucket;
+        const u32 shift{ bucket / sub_buckets - 1 };
+        return (u64)(sub_buckets + bucket % sub_buckets) << shift;
+    }
+
+    // The frames in the window, oldest first: frame number, frame time and the time of each stage in microseconds.
+    [[nodiscard]] std::string to_csv() const
+    {
+        std::string text{ "frame,frame_us" };
+        for (const char* name : _stage_names)
+        {
+            text += ",";
+            csv_escape(text, name);
+        }
+        text += "\n";
+
+        char buffer[64];
+        const u64 count{ window_count() };
+        for (u64 frame{ _frame_count - count }; frame < _frame_count; ++frame)
+        {
+            const u32 slot{ (u32)(frame % _window_size) };
+            snprintf(buffer, sizeof(buffer), "%llu,%.3f", (unsigned long long)frame, _frames[slot] * 1e-3);
+            text += buffer;
+            for (u32 i{ 0 }; i < stage_count(); ++i)
+            {
+                snprintf(buffer, sizeof(buffer), ",%.3f", _stage_ns[i * _window_size + slot] * 1e-3);
+                text += buffer;
+            }
+            text += "\n";
+        }
+
+        return text;
+    }
+
+    // Distributions of the frame and its stages, the histogram (non-empty buckets only) and the recent hitches.
+    [[nodiscard]] std::string to_json() const
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "{\n\"frames\":%llu,\n\"hitch_threshold_ms\":%.3f,\n\"hitch_count\":%llu,\n\"max_ms\":%.6f,\n\"frame\":",
+                 (unsigned long long)_frame_count, _hitch_threshold_ns * 1e-6, (unsigned long long)_hitch_count, max_ms());
+        std::string text{ buffer };
+        append_json(text, frame_distribution());
+
+        text += ",\n\"stages\":[";
+        for (u32 i{ 0 }; i < stage_count(); ++i)
+        {
+            text += i ? ",\n{\"name\":\"" : "\n{\"name\":\"";
+            json_escape(text, stage_name(i));
+            text += "\",\"time\":";
+            append_json(text, stage_distribution(i));
+            text += "}";
+        }
+
+        text += "],\n\"histogram\":[";
+        bool first{ true };
+        for (u32 i{ 0 }; i < bucket_count; ++i)
+        {
+            if (!_histogram[i]) continue;
+            snprintf(buffer, sizeof(buffer), "%s{\"from_us\":%llu,\"count\":%llu}", first ? "" : ",",
+                     (unsigned long long)bucket_lower_bound_us(i), (unsigned long long)_histogram[i]);
+            text += buffer;
+            first = false;
+        }
+
+        text += "],\n\"hitches\":[";
+        hitch hitches[max_hitches];
+        const u32 count{ get_hitches(&hitches[0]) };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            snprintf(buffer, sizeof(buffer), "%s{\"frame\":%llu,\"ms\":%.3f,\"slowest_stage\":\"", i ? "," : "",
+                     (unsigned long long)hitches[i].frame, hitches[i].duration_ns * 1e-6);
+            text += buffer;
+            if (hitches[i].slowest_stage != u32_invalid_id) json_escape(text, stage_name(hitches[i].slowest_stage));
+            text += "\"}";
+        }
+
+        text += "]\n}\n";
+        return text;
+    }
+
+    // Saves to_json() if the path ends with ".json", otherwise to_csv().
+    bool save(const char* path) const
+    {
+        assert(path);
+        const size_t length{ strlen(path) };
+        const bool json{ length >= 5 && !strcmp(path + length - 5, ".json") };
+        const std::string text{ json ? to_json() : to_csv() };
+        std::ofstream file{ path, std::ios::out | std::ios::binary };
+        if (!file) return false;
+        file.write(text.data(), text.size());
+        return file.good();
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    [[nodiscard]] u64 window_count() const
+    {
+        return _frame_count < _window_size ? _frame_count : _window_size;
+    }
+
+    [[nodiscard]] constexpr static u32 bucket(u64 nanoseconds)
+    {
+        u64 us{ nanoseconds / 1000 };
+        if (us > u32_invalid_id) us = u32_invalid_id;
+        if (us < sub_buckets) return (u32)us;
+        // NOTE: the top bit selects the power of two and the next 2 bits the bucket within it.
+        const u32 shift{ (u32)std::bit_width(us) - 3 };
+        return (shift + 1) * sub_buckets + (u32)(us >> shift) - sub_buckets;
+    }
+
+    [[nodiscard]] time_distribution distribution(const u64 *const samples) const
+    {
+        const u32 count{ (u32)window_count() };
+        time_distribution d{};
+        d.count = count;
+        if (!count) return d;
+
+        // NOTE: the window isn't in order after it wrapped around, but that doesn't matter here.
+        _sorted.resize(count);
+        memcpy(_sorted.data(), samples, count * sizeof(u64));
+        std::sort(_sorted.begin(), _sorted.end());
+
+        u64 sum{ 0 };
+        for (const u64 ns : _sorted) sum += ns;
+        const auto percentile = [this, count](f64 p)
+        {
+            const u32 rank{ (u32)(p * count + 0.999999) };
+            return _sorted[(rank ? rank : 1) - 1] * 1e-6;
+        };
+
+        d.average_ms = (f64)sum / count * 1e-6;
+        d.p50_ms = percentile(0.5);
+        d.p90_ms = percentile(0.9);
+        d.p99_ms = percentile(0.99);
+        d.p999_ms = percentile(0.999);
+        d.max_ms = _sorted[count - 1] * 1e-6;
+        return d;
+    }
+
+    static void append_json(std::string& text, const time_distribution& d)
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "{\"count\":%u,\"average_ms\":%.6f,\"p50_ms\":%.6f,\"p90_ms\":%.6f,\"p99_ms\":%.6f,\"p999_ms\":%.6f,\"max_ms\":%.6f}",
+                 d.count, d.average_ms, d.p50_ms, d.p90_ms, d.p99_ms, d.p999_ms, d.max_ms);
+        text += buffer;
+    }
+
+    static void json_escape(std::string& text, const char* s)
+    {
+        for (; *s; ++s)
+        {
+            if (*s == '"' || *s == '\\') text += '\\';
+            if ((u8)*s < 0x20) continue;
+            text += *s;
+        }
+    }
+
+    static void csv_escape(std::string& text, const char* s)
+    {
+        text += '"';
+        for (; *s; ++s)
+        {
+            if (*s == '"') text += '"';
+            text += *s;
+        }
+        text += '"';
+    }
+
+    utl::vector<u64>                _frames;
+    // Stage times of the window, one stage after the other.
+    utl::vector<u64>                _stage_ns;
+    utl::vector<u64>                _current_stage_ns;
+    utl::vector<const char*>        _stage_names;
+    mutable utl::vector<u64>        _sorted;
+    u64                             _histogram[bucket_count]{};
+    hitch                           _hitches[max_hitches]{};
+    u64                             _frame_count{ 0 };
+    u64                             _hitch_count{ 0 };
+    u64                             _max_ns{ 0 };
+    u64                             _hitch_threshold_ns;
+    const u32                       _window_size;
+    clock::time_point               _last_end{};
+};
+}
\ No newline at end of file
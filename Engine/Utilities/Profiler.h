@@ -0,0 +1,350 @@
+#pragma once
+#include "CommonHeaders.h"
+
+// CPU profiler with scope markers. Every thread records the begin and end time of its scopes
+// in its own ring buffer, so recording doesn't need any locks. Once per frame, end_frame()
+// turns the new events into hierarchical per-frame statistics. The events that are still
+// in the ring buffers can be saved in the Chrome trace format (chrome://tracing or Perfetto).
+//
+// Usage:
+//     void update() { PROFILE_FUNCTION(); ... { PROFILE_SCOPE("physics"); ... } }
+//
+// NOTE: scope names must be string literals (or live as long as the profiler), because
+//       only their pointers are recorded. In shipping builds, the markers compile to nothing.
+#if !defined(SHIPPING)
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) const primal::profiler::scope PROFILE_CONCAT(profile_scope_, __LINE__){ name }
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) primal::profiler::set_thread_name(name)
+
+namespace primal::profiler {
+
+struct scope_stats
+{
+    const char*     name;
+    u32             depth;
+    u32             parent;         // index of the parent scope, or u32_invalid_id.
+    u32             calls;          // number of calls in the last frame.
+    f32             total_ms;       // total time in the last frame, including child scopes.
+    f32             self_ms;        // total time in the last frame, excluding child scopes.
+    f32             average_ms;     // moving average of total_ms.
+};
+
+namespace detail {
+
+using clock = std::chrono::steady_clock;
+// NOTE: 16K events of 24 bytes each is 384 KB per thread.
+constexpr u32 buffer_capacity{ 1 << 14 };
+constexpr u64 buffer_mask{ buffer_capacity - 1 };
+
+struct event
+{
+    const char*     name;
+    u64             begin;      // nanoseconds since the profiler started.
+    u32             duration;   // nanoseconds.
+    u32             depth;
+};
+
+struct thread_buffer
+{
+    event               events[buffer_capacity];
+    // Number of events written so far. Only the recording thread writes it.
+    std::atomic<u64>    count{ 0 };
+    // First event that hasn't been aggregated yet. Only used by end_frame().
+    u64                 aggregated{ 0 };
+    u32                 depth{ 0 };
+    u32                 thread_id{ 0 };
+    std::string         name;
+};
+
+struct stats_node
+{
+    const char*     name;
+    u32             parent;
+    u32             depth;
+    u32             calls;
+    u64             total;
+    u64             children;
+    f32             average_ms;
+};
+
+struct profiler_state
+{
+    std::mutex                                  mutex;
+    utl::vector<std::unique_ptr<thread_buffer>> threads;
+    clock::time_point                           start{ clock::now() };
+
+    // Hierarchical statistics. Nodes are identified by their parent and their name.
+    std::mutex                                  stats_mutex;
+    utl::vector<stats_node>                     nodes;
+    utl::vector<event>                          frame_events;
+    u64                                         lost_events{ 0 };
+};
+
+inline profiler_state&
+state()
+{
+    static profiler_state s;
+    return s;
+}
+
+inline u64
+now()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - state().start).count();
+}
+
+inline thread_buffer&
+get_thread_buffer()
+{
+    thread_local thread_buffer* buffer{ nullptr };
+    if (!buffer)
+    {
+        profiler_state& s{ state() };
+        std::lock_guard lock{ s.mutex };
+        buffer = s.threads.emplace_back(std::make_unique<thread_buffer>()).get();
+        buffer->thread_id = (u32)s.threads.size() - 1;
+    }
+
+    return *buffer;
+}
+
+// Copies the events [first, thread.count) that are still in the ring buffer.
+// Returns the index after the last copied event.
+inline u64
+copy_events(const thread_buffer& thread, u64 first, utl::vector<event>& events)
+{
+    const u64 count{ thread.count.load(std::memory_order_acquire) };
+    if (count - first > buffer_capacity) first = count - buffer_capacity;
+    const u64 copied_from{ events.size() };
+    for (u64 i{ first }; i < count; ++i) events.emplace_back(thread.events[i & buffer_mask]);
+
+    // NOTE: the thread might have overwritten some of the events while we were copying them.
+    //       Those were the oldest ones, so we remove them from the front.
+    const u64 written{ thread.count.load(std::memory_order_acquire) };
+    if (written - first > buffer_capacity)
+    {
+        const u64 overwritten{ written - buffer_capacity - first };
+        const u64 lost{ overwritten < count - first ? overwritten : count - first };
+        const u64 valid{ count - first - lost };
+        for (u64 i{ 0 }; i < valid; ++i) events[copied_from + i] = events[copied_from + lost + i];
+        events.resize(copied_from + valid);
+    }
+
+    return count;
+}
+
+inline u32
+find_node(const char* name, u32 parent, u32 depth)
+{
+    auto& nodes{ state().nodes };
+    for (u32 i{ 0 }; i < nodes.size(); ++i)
+    {
+        const stats_node& n{ nodes[i] };
+        if (n.parent == parent && (n.name == name || !strcmp(n.name, name))) return i;
+    }
+
+    nodes.emplace_back(stats_node{ name, parent, depth, 0, 0, 0, 0.f });
+    return (u32)nodes.size() - 1;
+}
+
+inline void
+json_escape(std::string& text, const char* s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\') text += '\\';
+        if ((u8)*s < 0x20) continue;
+        text += *s;
+    }
+}
+
+} // namespace detail
+
+class scope
+{
+public:
+    explicit scope(const char* name)
+        : _name{ name }, _buffer{ detail::get_thread_buffer() }, _depth{ _buffer.depth++ }, _begin{ detail::now() } {}
+
+    ~scope()
+    {
+        const u64 end{ detail::now() };
+        --_buffer.depth;
+        const u64 index{ _buffer.count.load(std::memory_order_relaxed) };
+        _buffer.events[index & detail::buffer_mask] = detail::event{ _name, _begin, (u32)(end - _begin), _depth };
+        _buffer.count.store(index + 1, std::memory_order_release);
+    }
+
+    DISABLE_COPY_AND_MOVE(scope);
+
+private:
+    const char*                 _name;
+    detail::thread_buffer&      _buffer;
+    const u32                   _depth;
+    const u64                   _begin;
+};
+
+inline void
+set_thread_name(const char* name)
+{
+    detail::get_thread_buffer().name = name;
+}
+
+// Aggregates the events that were recorded since the last call into per-frame statistics.
+// NOTE: scopes that are still open (e.g. the scope of the frame itself) are counted in the next frame.
+inline void
+end_frame()
+{
+    using namespace detail;
+    constexpr f32 average_weight{ 0.1f };
+    profiler_state& s{ state() };
+    std::lock_guard stats_lock{ s.stats_mutex };
+
+    for (stats_node& n : s.nodes)
+    {
+        n.calls = 0;
+        n.total = 0;
+        n.children = 0;
+    }
+
+    utl::vector<thread_buffer*> threads;
+    {
+        std::lock_guard lock{ s.mutex };
+        for (auto& thread : s.threads) threads.emplace_back(thread.get());
+    }
+
+    utl::vector<event>& events{ s.frame_events };
+    // Open scopes of one thread, by depth: node index and end time.
+    utl::vector<std::pair<u32, u64>> stack;
+    for (thread_buffer* const t : threads)
+    {
+        thread_buffer& thread{ *t };
+        events.clear();
+        const u64 first{ thread.aggregated };
+        const u64 end{ copy_events(thread, first, events) };
+        if (end - first > events.size()) s.lost_events += end - first - events.size();
+        thread.aggregated = end;
+        if (events.empty()) continue;
+
+        // Events are recorded when they end, so we sort them by when they began.
+        // This way, a parent scope always comes before its children.
+        std::sort(events.begin(), events.end(), [](const event& a, const event& b)
+                  {
+                      return a.begin != b.begin ? a.begin < b.begin : a.depth < b.depth;
+                  });
+
+        stack.clear();
+        for (const event& e : events)
+        {
+            const u64 e_end{ e.begin + e.duration };
+            while (!stack.empty() && (stack.size() > e.depth || stack.back().second < e_end)) stack.resize(stack.size() - 1);
+
+            const u32 parent{ stack.empty() ? u32_invalid_id : stack.back().first };
+            const u32 node{ find_node(e.name, parent, (u32)stack.size()) };
+            s.nodes[node].calls += 1;
+            s.nodes[node].total += e.duration;
+            if (parent != u32_invalid_id) s.nodes[parent].children += e.duration;
+            stack.emplace_back(node, e_end);
+        }
+    }
+
+    for (stats_node& n : s.nodes)
+    {
+        const f32 ms{ n.total * 1e-6f };
+        n.average_ms = n.average_ms > 0.f ? n.average_ms + (ms - n.average_ms) * average_weight : ms;
+    }
+}
+
+// Returns the number of scopes in the hierarchy. If stats isn't null, it's filled with the
+// statistics of the last frame. Child scopes always come after their parent.
+inline u32
+get_frame_stats(scope_stats *const stats)
+{
+    using namespace detail;
+    profiler_state& s{ state() };
+    std::lock_guard lock{ s.stats_mutex };
+    const u32 count{ (u32)s.nodes.size() };
+    if (!stats) return count;
+
+    for (u32 i{ 0 }; i < count; ++i)
+    {
+        const stats_node& n{ s.nodes[i] };
+        const u64 self{ n.total > n.children ? n.total - n.children : 0 };
+        stats[i] = scope_stats{ n.name, n.depth, n.parent, n.calls, n.total * 1e-6f, self * 1e-6f, n.average_ms };
+    }
+
+    return count;
+}
+
+// Returns the events that are still in the ring buffers in the Chrome trace event format.
+inline std::string
+get_chrome_trace()
+{
+    using namespace detail;
+    profiler_state& s{ state() };
+    utl::vector<thread_buffer*> threads;
+    {
+        std::lock_guard lock{ s.mutex };
+        for (auto& thread : s.threads) threads.emplace_back(thread.get());
+    }
+
+    std::string text{ "{\"traceEvents\":[\n" };
+    char buffer[128];
+    bool first{ true };
+    utl::vector<event> events;
+    for (const thread_buffer* thread : threads)
+    {
+        if (!thread->name.empty())
+        {
+            snprintf(buffer, sizeof(buffer), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"",
+                     first ? "" : ",\n", thread->thread_id);
+            text += buffer;
+            json_escape(text, thread->name.c_str());
+            text += "\"}}";
+            first = false;
+        }
+
+        events.clear();
+        copy_events(*thread, 0, events);
+        for (const event& e : events)
+        {
+            text += first ? "{\"name\":\"" : ",\n{\"name\":\"";
+            json_escape(text, e.name);
+            snprintf(buffer, sizeof(buffer), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                     e.begin * 1e-3, e.duration * 1e-3, thread->thread_id);
+            text += buffer;
+            first = false;
+        }
+    }
+
+    text += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return text;
+}
+
+inline bool
+save_chrome_trace(const char* path)
+{
+    assert(path);
+    const std::string text{ get_chrome_trace() };
+    std::ofstream file{ path, std::ios::out | std::ios::binary };
+    if (!file) return false;
+    file.write(text.data(), text.size());
+    return file.good();
+}
+
+}
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif // !defined(SHIPPING)
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include "Common.h"
 #include "CommonHeaders.h"
 #include "..\Engine\Components\Script.h"
+#include "..\Engine\Core\Metrics.h"
 #include "..\Graphics\Renderer.h"
 #include "..\Platform\PlatformTypes.h"
 #include "..\Platform\Platform.h"
+#include "..\Utilities\Profiler.h"
 
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -90,3 +92,32 @@ ResizeRenderSurface(u32 id)
     assert(id < surfaces.size());
     surfaces[id].window.resize(0, 0);
 }
+
+EDITOR_INTERFACE u32
+SaveProfilerTrace(const char* path)
+{
+    assert(path);
+    return profiler::save_chrome_trace(path) ? TRUE : FALSE;
+}
+
+// Takes a snapshot of the engine metrics and returns the number of metrics.
+EDITOR_INTERFACE u32
+UpdateEngineMetrics()
+{
+    metrics::end_frame();
+    return metrics::get_metrics(nullptr);
+}
+
+// Copies the last snapshot. values should have room for the count returned by UpdateEngineMetrics().
+EDITOR_INTERFACE u32
+GetEngineMetrics(metrics::metric_value* values)
+{
+    return metrics::get_metrics(values);
+}
+
+EDITOR_INTERFACE u32
+SaveEngineMetrics(const char* path)
+{
+    assert(path);
+    return metrics::save(path) ? TRUE : FALSE;
+}
\ No newline at end of file
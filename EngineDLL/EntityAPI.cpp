@@ -5,6 +5,7 @@
 #include "..\Engine\Components\Entity.h"
 #include "..\Engine\Components\Transform.h"
 #include "..\Engine\Components\Script.h"
+#include "..\Engine\Components\Snapshot.h"
 
 using namespace primal;
 
@@ -49,6 +50,10 @@ struct game_entity_descriptor
     script_component script;
 };
 
+// Snapshot of the world that's used to reset the scene after play-in-editor.
+std::unique_ptr<u8[]> world_snapshot{};
+u64 world_snapshot_size{ 0 };
+
 game_entity::entity entity_from_id(id::id_type id)
 {
     return game_entity::entity{ game_entity::entity_id{id} };
@@ -76,4 +81,17 @@ RemoveGameEntity(id::id_type id)
 {
     assert(id::is_valid(id));
     game_entity::remove(game_entity::entity_id{ id });
+}
+
+EDITOR_INTERFACE u32
+SaveWorldSnapshot()
+{
+    return snapshot::save(world_snapshot, world_snapshot_size) ? 1 : 0;
+}
+
+EDITOR_INTERFACE u32
+RestoreWorldSnapshot()
+{
+    if (!world_snapshot) return 0;
+    return snapshot::restore(world_snapshot.get(), world_snapshot_size) ? 1 : 0;
 }
\ No newline at end of file
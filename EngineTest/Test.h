@@ -17,11 +17,12 @@ public:
 
 #if _WIN64
 #include <Windows.h>
+#include "Utilities\FrameStatistics.h"
 class time_it
 {
 public:
-    using clock = std::chrono::high_resolution_clock;
-    using time_stamp = std::chrono::steady_clock::time_point;
+    using clock = std::chrono::steady_clock;
+    using time_stamp = clock::time_point;
 
     void begin()
     {
@@ -31,26 +32,28 @@ public:
     void end()
     {
         auto dt = clock::now() - _start;
-        _ms_avg += ((float)std::chrono::duration_cast<std::chrono::milliseconds>(dt).count() - _ms_avg) / (float)_counter;
+        _stats.record_frame((u64)std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count());
         ++_counter;
 
         if (std::chrono::duration_cast<std::chrono::seconds>(clock::now() - _seconds).count() >= 1)
         {
-            OutputDebugStringA("Avg. frame (ms): ");
-            OutputDebugStringA(std::to_string(_ms_avg).c_str());
-            OutputDebugStringA((" " + std::to_string(_counter)).c_str());
-            OutputDebugStringA(" fps");
-            OutputDebugStringA("\n");
-            _ms_avg = 0.f;
-            _counter = 1;
+            const primal::utl::time_distribution frames{ _stats.frame_distribution() };
+            char text[256];
+            snprintf(text, sizeof(text), "Frame (ms): avg %.3f, p50 %.3f, p99 %.3f, max %.3f, %d fps\n",
+                     frames.average_ms, frames.p50_ms, frames.p99_ms, frames.max_ms, _counter);
+            OutputDebugStringA(text);
+            _counter = 0;
             _seconds = clock::now();
         }
     }
 
+    // Frame times of the last 256 frames and the histogram of all frames (see FrameStatistics.h).
+    const primal::utl::frame_statistics& stats() const { return _stats; }
+
 private:
-    float       _ms_avg{ 0.f };
-    int         _counter{ 1 };
-    time_stamp  _start;
-    time_stamp  _seconds{ clock::now() };
+    primal::utl::frame_statistics   _stats{ 256 };
+    int                             _counter{ 0 };
+    time_stamp                      _start;
+    time_stamp                      _seconds{ clock::now() };
 };
 #endif // _WIN64
@@ -3,12 +3,50 @@
 #include "Test.h"
 #include "..\Engine\Components\Entity.h"
 #include "..\Engine\Components\Transform.h"
+#include "..\Engine\Components\Recording.h"
+#include "..\Engine\Components\Script.h"
+#include "..\Engine\EngineAPI\GameEntity.h"
 
 #include <iostream>
 #include <ctime>
 
 using namespace primal;
 
+namespace {
+u32 running_tasks{ 0 };
+u32 task_steps{ 0 };
+
+// Starts a coroutine in begin_play() and lowers its own update rate while the coroutine is suspended.
+class task_script : public script::entity_script
+{
+public:
+    constexpr explicit task_script(game_entity::entity entity)
+        : script::entity_script{ entity } {}
+
+    void begin_play() override
+    {
+        start(count_frames());
+        script().set_update_rate(script::update_rate::every_n_frames(4));
+    }
+
+private:
+    script::task count_frames()
+    {
+        struct counter
+        {
+            counter() { ++running_tasks; }
+            ~counter() { --running_tasks; }
+        } c{};
+
+        while (true)
+        {
+            ++task_steps;
+            co_await script::next_frame{};
+        }
+    }
+};
+} // anonymous namespace
+
 class engine_test : public test
 {
 public:
@@ -20,14 +58,21 @@ public:
 
     void run() override
     {
+        test_script_tasks();
+
+        // The first pass is recorded and replayed, so its timings can be compared
+        // against the same sequence of operations in later runs.
+        recording::begin_recording();
         do {
             for (u32 i{ 0 }; i < 10000; ++i)
             {
                 create_random();
                 remove_random();
                 _num_entities = (u32)_entities.size();
+                recording::mark_frame();
             }
             print_results();
+            if (recording::is_recording()) replay_first_pass();
         } while (getchar() != 'q');
     }
 
@@ -76,12 +121,59 @@ private:
         }
     }
 
+    // The coroutine must keep running after the update rate changed and it must be
+    // cancelled when its script is removed.
+    void test_script_tasks()
+    {
+        transform::init_info transform_info{};
+        script::init_info script_info{ &script::detail::create_script<task_script> };
+        game_entity::entity_info entity_info{ &transform_info, &script_info };
+        const game_entity::entity entity{ game_entity::create(entity_info) };
+        assert(entity.is_valid() && running_tasks == 1 && task_steps == 1);
+
+        for (u32 i{ 0 }; i < 3; ++i) script::update(1.f / 60.f);
+        assert(running_tasks == 1 && task_steps == 4);
+
+        entity.script().set_update_rate(script::update_rate::every_seconds(0.5f));
+        script::update(1.f / 60.f);
+        assert(running_tasks == 1 && task_steps == 5);
+
+        // NOTE: cancelled coroutines are destroyed when they would have resumed.
+        game_entity::remove(entity.get_id());
+        script::update(1.f / 60.f);
+        assert(running_tasks == 0 && task_steps == 5);
+        std::cout << (running_tasks == 0 && task_steps == 5 ? "Script tasks: OK\n" : "Script tasks: FAILED\n");
+    }
+
     void print_results()
     {
         std::cout << "Entities created: " << _added << "\n";
         std::cout << "Entities deleted: " << _removed << "\n";
     }
 
+    // NOTE: the replay starts from the same (empty) world, so the entities get the same ids
+    //       and _entities is still valid after the replay.
+    void replay_first_pass()
+    {
+        std::unique_ptr<u8[]> data;
+        u64 size{ 0 };
+        recording::end_recording(data, size);
+
+        utl::frame_statistics frame_times{ 10000 };
+        recording::replay_stats stats{};
+        if (!recording::replay(data.get(), size, stats, &frame_times))
+        {
+            std::cout << "Replay failed\n";
+            return;
+        }
+
+        const utl::time_distribution frames{ frame_times.frame_distribution() };
+        std::cout << "Replayed " << stats.operations << " operations (" << size / 1024 << " KB) in "
+                  << stats.frames << " frames: " << stats.total_ms << " ms\n";
+        std::cout << "Frame time (ms): p50 " << frames.p50_ms << ", p99 " << frames.p99_ms
+                  << ", max " << stats.max_frame_ms << "\n";
+    }
+
     utl::vector<game_entity::entity> _entities;
 
     u32 _added{ 0 };
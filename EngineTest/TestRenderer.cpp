@@ -84,7 +84,9 @@ LRESULT win_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
                 }
                 else
                 {
-                    _surfaces[i].surface.resize(win.width(), win.height());
+                    // NOTE: the resize is applied at the start of the next frame. While the user
+                    //       drags the window border, only the last size is applied.
+                    graphics::post_resize_surface(_surfaces[i].surface.get_id(), win.width(), win.height());
                     resized = false;
                 }
                 break;
@@ -143,6 +145,8 @@ test_initialize()
 void
 test_shutdown()
 {
+    // NOTE: apply the pending resizes before the surfaces are removed.
+    graphics::process_commands();
     for (u32 i{ 0 }; i < _countof(_surfaces); ++i)
         destroy_render_surface(_surfaces[i]);
 
@@ -160,6 +164,7 @@ engine_test::run()
 {
     timer.begin();
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    graphics::process_commands();
     for (u32 i{ 0 }; i < _countof(_surfaces); ++i)
     {
         if (_surfaces[i].surface.is_valid())